@@ -0,0 +1,6380 @@
+#ifndef TABLE_H_
+#define TABLE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TABLE_POSIX_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TABLE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#ifndef TABLE_NO_STATS
+#define TABLE_STATS
+#endif
+
+// Класс Stats - Счетчики и гистограммы задержек горячих путей таблицы.
+// Каждый поток пишет в собственный набор счетчиков обычными (не
+// атомарными read-modify-write) операциями, а снимок складывает наборы
+// всех потоков. Набор завершившегося потока достается следующему новому
+// потоку, поэтому наборов не больше, чем одновременно живших потоков.
+// Если определен TABLE_NO_STATS, методы записи пусты и вырезаются
+// компилятором, а снимок содержит нули.
+
+class Stats {
+public:
+    enum Counter {
+        READ_CALLS,         // Вызовы readFromFile
+        READ_FAILURES,      // Неудачные чтения (нет файла, ошибка формата)
+        READ_BYTES,         // Прочитано байт
+        READ_ROWS,          // Прочитано строк
+        READ_TEXT_FIELDS,   // Поля, прочитанные как текст (при ленивом
+                            // чтении - при разборе столбца)
+        READ_PADDED_ROWS,   // Короткие строки, дополненные пустыми ячейками
+        FORMULA_CALLS,      // Вызовы calculateFormula
+        FORMULA_CELLS,      // Ячейки в диапазонах calculateFormula
+        CELL_ALLOCATIONS,   // Ячейки, выделенные в куче (getCell, getMatrix)
+        STRING_ALLOCATIONS, // Новые строки в пуле строк
+        RENDER_CALLS,       // Выводы таблицы
+        RENDER_CELLS,       // Выведенные ячейки
+        CONCAT_CALLS,       // Конкатенации таблиц (+, +=, appendRows)
+        GROUP_SPILLED_ROWS, // Строки группировки, отложенные на диск
+        COUNTERS            // Кол-во счетчиков
+    };
+
+    enum Latency {
+        READ,            // readFromFile
+        FORMULA_SUM,     // calculateFormula с операцией SUM
+        FORMULA_PRODUCT, // calculateFormula с операцией PRODUCT
+        FORMULA_AVERAGE, // calculateFormula с операцией AVERAGE
+        RENDER,          // Вывод таблицы
+        CONCAT,          // Конкатенация таблиц
+        LATENCIES        // Кол-во замеряемых операций
+    };
+
+    enum Format { JSON, PROMETHEUS }; // Форматы выгрузки снимка
+
+    static constexpr size_t kBuckets = 40; // Интервалы гистограммы задержек:
+                                           // k-й - [2^k, 2^(k+1)) нс
+
+    struct Snapshot { // Сумма счетчиков всех потоков на момент снимка
+        uint64_t counters[COUNTERS];           // Значения счетчиков
+        uint64_t calls[LATENCIES];             // Кол-во замеров
+        uint64_t nanoseconds[LATENCIES];       // Суммарное время, нс
+        uint64_t buckets[LATENCIES][kBuckets]; // Гистограммы задержек
+
+        double seconds(Latency latency) const { // Суммарное время, с
+            return nanoseconds[latency] * 1e-9;
+        }
+
+        double quantile(Latency latency, double q)
+            const { // Верхняя граница интервала гистограммы, в который
+                    // попадает доля q замеров, с
+            uint64_t rank = static_cast<uint64_t>(q * calls[latency]);
+            uint64_t seen = 0;
+            for (size_t k = 0; k < kBuckets; k++) {
+                seen += buckets[latency][k];
+                if (seen > rank) {
+                    return bound(k);
+                }
+            }
+            return calls[latency] > 0 ? bound(kBuckets - 1) : 0.0;
+        }
+
+        double readBytesPerSecond() const { // Скорость чтения, байт/с
+            return seconds(READ) > 0 ? counters[READ_BYTES] / seconds(READ)
+                                     : 0.0;
+        }
+
+        double readRowsPerSecond() const { // Скорость чтения, строк/с
+            return seconds(READ) > 0 ? counters[READ_ROWS] / seconds(READ)
+                                     : 0.0;
+        }
+
+        void writeJson(std::ostream& os) const { // Вывод снимка в JSON
+            os << "{\n  \"enabled\": " << (enabled() ? "true" : "false")
+               << ",\n  \"counters\": {";
+            for (size_t c = 0; c < COUNTERS; c++) {
+                os << (c > 0 ? "," : "") << "\n    \""
+                   << counterName(static_cast<Counter>(c))
+                   << "\": " << counters[c];
+            }
+            os << "\n  },\n  \"read_bytes_per_second\": "
+               << readBytesPerSecond()
+               << ",\n  \"read_rows_per_second\": " << readRowsPerSecond()
+               << ",\n  \"latencies\": {";
+            for (size_t l = 0; l < LATENCIES; l++) {
+                Latency latency = static_cast<Latency>(l);
+                os << (l > 0 ? "," : "") << "\n    \"" << latencyName(latency)
+                   << "\": {\"calls\": " << calls[l]
+                   << ", \"seconds\": " << seconds(latency)
+                   << ", \"p50_seconds\": " << quantile(latency, 0.5)
+                   << ", \"p99_seconds\": " << quantile(latency, 0.99)
+                   << ", \"buckets\": [";
+                for (size_t k = 0; k < kBuckets; k++) {
+                    os << (k > 0 ? ", " : "") << buckets[l][k];
+                }
+                os << "]}";
+            }
+            os << "\n  }\n}\n";
+        }
+
+        void writePrometheus(
+            std::ostream& os) const { // Вывод снимка в текстовом формате
+                                      // Prometheus
+            for (size_t c = 0; c < COUNTERS; c++) {
+                const char* name = counterName(static_cast<Counter>(c));
+                os << "# TYPE table_" << name << "_total counter\n"
+                   << "table_" << name << "_total " << counters[c] << "\n";
+            }
+            os << "# TYPE table_latency_seconds histogram\n";
+            for (size_t l = 0; l < LATENCIES; l++) {
+                Latency     latency = static_cast<Latency>(l);
+                std::string label   = std::string("operation=\"") +
+                                      latencyName(latency) + "\"";
+                uint64_t    seen    = 0;
+                for (size_t k = 0; k < kBuckets; k++) {
+                    seen += buckets[l][k];
+                    os << "table_latency_seconds_bucket{" << label
+                       << ",le=\"" << bound(k) << "\"} " << seen << "\n";
+                }
+                os << "table_latency_seconds_bucket{" << label
+                   << ",le=\"+Inf\"} " << calls[l] << "\n"
+                   << "table_latency_seconds_sum{" << label << "} "
+                   << seconds(latency) << "\n"
+                   << "table_latency_seconds_count{" << label << "} "
+                   << calls[l] << "\n";
+            }
+        }
+
+        void save(const std::string& filename,
+                  Format format = JSON) const { // Запись снимка в файл
+            std::ofstream file(filename, std::ios::trunc);
+            if (!file) {
+                throw std::runtime_error("Не удалось открыть файл " +
+                                         filename);
+            }
+            if (format == JSON) {
+                writeJson(file);
+            } else {
+                writePrometheus(file);
+            }
+            if (!file) {
+                throw std::runtime_error("Ошибка записи в файл " + filename);
+            }
+        }
+
+        static double bound(size_t k) { // Верхняя граница k-го интервала, с
+            return static_cast<double>(uint64_t(2) << k) * 1e-9;
+        }
+    };
+
+    class Scope { // Замер времени выполнения блока кода
+    private:
+#ifdef TABLE_STATS
+        Latency                               latency; // Замеряемая операция
+        std::chrono::steady_clock::time_point started; // Начало замера
+#endif
+
+    public:
+#ifdef TABLE_STATS
+        explicit Scope(Latency operation)
+            : latency(operation), started(std::chrono::steady_clock::now()) {}
+        ~Scope() {
+            record(latency,
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - started)
+                       .count());
+        }
+#else
+        explicit Scope(Latency) {}
+#endif
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    static bool enabled() { // Собрана ли библиотека со статистикой
+#ifdef TABLE_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void add(Counter counter, uint64_t value = 1) { // Увеличение
+                                                           // счетчика
+#ifdef TABLE_STATS
+        bump(local().counters[counter], value);
+#else
+        (void)counter;
+        (void)value;
+#endif
+    }
+
+    static void record(Latency latency, uint64_t nanoseconds) { // Замер
+#ifdef TABLE_STATS
+        size_t bucket = 0;
+        while (bucket + 1 < kBuckets && (nanoseconds >> (bucket + 1)) != 0) {
+            bucket++;
+        }
+        Shard& shard = local();
+        bump(shard.calls[latency], 1);
+        bump(shard.nanoseconds[latency], nanoseconds);
+        bump(shard.buckets[latency][bucket], 1);
+#else
+        (void)latency;
+        (void)nanoseconds;
+#endif
+    }
+
+    static Snapshot snapshot() { // Снимок: сумма наборов всех потоков
+        Snapshot result = {};
+#ifdef TABLE_STATS
+        Registry&                   shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for (const Shard& shard : shared.shards) {
+            for (size_t c = 0; c < COUNTERS; c++) {
+                result.counters[c] += shard.counters[c].load(
+                    std::memory_order_relaxed);
+            }
+            for (size_t l = 0; l < LATENCIES; l++) {
+                result.calls[l] +=
+                    shard.calls[l].load(std::memory_order_relaxed);
+                result.nanoseconds[l] +=
+                    shard.nanoseconds[l].load(std::memory_order_relaxed);
+                for (size_t k = 0; k < kBuckets; k++) {
+                    result.buckets[l][k] +=
+                        shard.buckets[l][k].load(std::memory_order_relaxed);
+                }
+            }
+        }
+#endif
+        return result;
+    }
+
+    static const char* counterName(Counter counter) { // Имя счетчика
+        static const char* const names[COUNTERS] = {"read_calls",
+                                                    "read_failures",
+                                                    "read_bytes",
+                                                    "read_rows",
+                                                    "read_text_fields",
+                                                    "read_padded_rows",
+                                                    "formula_calls",
+                                                    "formula_cells",
+                                                    "cell_allocations",
+                                                    "string_allocations",
+                                                    "render_calls",
+                                                    "render_cells",
+                                                    "concat_calls",
+                                                    "group_spilled_rows"};
+        return names[counter];
+    }
+
+    static const char* latencyName(Latency latency) { // Имя операции
+        static const char* const names[LATENCIES] = {"read",
+                                                     "formula_sum",
+                                                     "formula_product",
+                                                     "formula_average",
+                                                     "render",
+                                                     "concat"};
+        return names[latency];
+    }
+
+private:
+#ifdef TABLE_STATS
+    struct Shard { // Набор счетчиков одного потока; пишет только владелец
+        std::atomic<uint64_t> counters[COUNTERS]           = {};
+        std::atomic<uint64_t> calls[LATENCIES]             = {};
+        std::atomic<uint64_t> nanoseconds[LATENCIES]       = {};
+        std::atomic<uint64_t> buckets[LATENCIES][kBuckets] = {};
+    };
+
+    struct Registry {               // Наборы всех потоков
+        std::mutex          mutex;  // Защищает списки наборов
+        std::deque<Shard>   shards; // Наборы (адреса не меняются)
+        std::vector<Shard*> free;   // Наборы завершившихся потоков
+    };
+
+    struct Owner { // Владение набором в течение жизни потока
+        Shard* shard;
+
+        Owner() {
+            Registry&                   shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if (shared.free.empty()) {
+                shared.shards.emplace_back();
+                shard = &shared.shards.back();
+            } else {
+                shard = shared.free.back();
+                shared.free.pop_back();
+            }
+        }
+
+        ~Owner() {
+            Registry&                   shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.free.push_back(shard);
+        }
+    };
+
+    static Registry& registry() { // Общий реестр наборов
+        static Registry shared;
+        return shared;
+    }
+
+    static Shard& local() { // Набор текущего потока
+        thread_local Owner owner;
+        return *owner.shard;
+    }
+
+    static void bump(std::atomic<uint64_t>& slot,
+                     uint64_t value) { // Прибавление без блокировки шины:
+                                       // в набор пишет только его поток
+        slot.store(slot.load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+    }
+#endif
+};
+
+// Класс StringPool - Пул длинных строк (словарь): одинаковые строки
+// хранятся один раз, а ячейки ссылаются на общую запись пула, поэтому
+// сравнение и хеширование таких ячеек - операции над адресами записей.
+// Запись считает своих владельцев (ячейки и кэши) и удаляется из пула
+// вместе с последним из них, так что пул хранит только строки живых ячеек,
+// а память таблицы освобождается вместе с ней. Чтение строки записи не
+// требует блокировки.
+
+class StringPool {
+public:
+    class Entry { // Запись пула: строка, хеш ее содержимого и кол-во
+                  // владельцев
+    private:
+        std::string                 text;  // Строка
+        uint64_t                    print; // Хеш содержимого
+        mutable std::atomic<size_t> refs;  // Кол-во владельцев записи
+
+        Entry(std::string_view value, uint64_t hash)
+            : text(value), print(hash), refs(1) {}
+
+        friend class StringPool;
+
+    public:
+        const std::string& str() const { return text; } // Строка записи
+        uint64_t hash() const { return print; } // Хеш содержимого (FNV-1a)
+    };
+
+private:
+    std::mutex mutex; // Защита словаря и удаления записей
+    std::unordered_map<std::string_view, Entry*> entries; // Строка -> запись
+
+    StringPool() {}
+
+public:
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    static StringPool& instance() { // Единственный пул программы; не
+                                    // разрушается, чтобы ячейки статических
+                                    // объектов можно было разрушить позже
+        static StringPool* pool = new StringPool();
+        return *pool;
+    }
+
+    static uint64_t hash(std::string_view text) { // FNV-1a по содержимому
+        uint64_t bits = 14695981039346656037ULL;
+        for (char c : text) {
+            bits = (bits ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return bits;
+    }
+
+    const Entry* intern(std::string_view text) { // Запись строки в пуле;
+                                                 // вызывающий становится
+                                                 // одним из ее владельцев
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(text);
+        if (found != entries.end()) {
+            found->second->refs.fetch_add(1, std::memory_order_relaxed);
+            return found->second;
+        }
+        Entry* entry = new Entry(text, hash(text));
+        entries.emplace(std::string_view(entry->text), entry);
+        Stats::add(Stats::STRING_ALLOCATIONS);
+        return entry;
+    }
+
+    static void retain(const Entry* entry) { // Новый владелец записи (его
+                                             // получает уже владеющий ею)
+        entry->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release(const Entry* entry) { // Отказ от владения записью;
+                                       // последний владелец удаляет ее.
+                                       // Пока владельцев больше одного,
+                                       // блокировка не нужна, а последний
+                                       // отказывается под блокировкой, чтобы
+                                       // intern не нашел удаляемую запись
+        size_t refs = entry->refs.load(std::memory_order_relaxed);
+        while (refs > 1) {
+            if (entry->refs.compare_exchange_weak(refs,
+                                                  refs - 1,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            entries.erase(std::string_view(entry->text));
+            delete entry;
+        }
+    }
+
+    size_t size() { // Кол-во строк в пуле
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    class Cache { // Кэш недавних записей одного потока: повторяющиеся
+                  // значения находятся без блокировки пула. Кэш владеет
+                  // своими записями до разрушения
+    private:
+        std::vector<const Entry*> slots; // Записи по хешу строки
+
+    public:
+        Cache() : slots(4096, nullptr) {}
+        ~Cache() {
+            for (const Entry* slot : slots) {
+                if (slot) {
+                    instance().release(slot);
+                }
+            }
+        }
+
+        Cache(const Cache&) = delete;
+        Cache& operator=(const Cache&) = delete;
+
+        const Entry* intern(std::string_view text) { // Запись строки;
+                                                     // вызывающий становится
+                                                     // одним из ее владельцев
+            const Entry*& slot =
+                slots[std::hash<std::string_view>()(text) & (slots.size() - 1)];
+            if (!slot || slot->str() != text) {
+                if (slot) {
+                    instance().release(slot);
+                }
+                slot = instance().intern(text);
+            }
+            retain(slot);
+            return slot;
+        }
+    };
+};
+
+// Класс Cell - Ячейка электронной таблицы: числовое или текстовое значение,
+// может быть пустой. Занимает 16 байт и не выделяет памяти: короткий текст
+// хранится прямо в ячейке, длинный - в пуле строк, и ячейка владеет его
+// записью.
+
+class Cell {
+public:
+    enum TypeCell : uint8_t { EMPTY, TEXT, NUMBER }; // Типы ячейки
+
+    static const size_t kInlineText = 14; // Макс. длина текста внутри ячейки
+
+    struct Tag {          // Служебная половина ячейки
+        char     tail[6]; // Окончание короткого текста
+        uint8_t  length;  // Длина короткого текста (kPooledText - из пула)
+        TypeCell type;    // Тип ячейки
+    };
+
+private:
+    static const uint8_t kPooledText = 0xFF; // Признак текста из пула строк
+
+    double payload; // Число, начало короткого текста или адрес записи пула
+    Tag    tag;     // Тип, длина и окончание короткого текста
+
+    Cell(double data, Tag info) : payload(data), tag(info) {
+        retain();
+    } // Сборка ячейки из половин, хранимых таблицей
+
+    friend class Column;
+    friend class TableFile;
+
+public:
+    Cell() : payload(0.0), tag() {} // Конструктор по-умолчанию
+    Cell(double num) : Cell() { setNumber(num); } // Конструктор для чисел
+    Cell(std::string_view txt) : Cell() {
+        setText(txt);
+    } // Конструктор для текста
+    Cell(const Cell& other) : payload(other.payload), tag(other.tag) {
+        retain();
+    } // Конструктор копирования
+    Cell(Cell&& other) noexcept : payload(other.payload), tag(other.tag) {
+        other.payload = 0.0;
+        other.tag     = Tag();
+    } // Конструктор перемещения
+    ~Cell() { release(); } // Деструктор
+
+    Cell& operator=(const Cell& other) { // Оператор присваивания
+        other.retain();
+        release();
+        payload = other.payload;
+        tag     = other.tag;
+        return *this;
+    }
+
+    Cell& operator=(Cell&& other) noexcept { // Присваивание перемещением
+        std::swap(payload, other.payload);
+        std::swap(tag, other.tag);
+        return *this;
+    }
+
+    TypeCell getType() const {
+        return tag.type;
+    } // Метод для получения типа ячейки
+    double getNumber() const { // Метод для получения числового значения
+        if (tag.type != NUMBER) {
+            throw std::runtime_error(
+                "Попытка взятия числа не из числовой ячейки!");
+        }
+        return payload;
+    }
+
+    std::string getText() const { // Метод для получения текста ячейки
+        if (tag.type != TEXT) {
+            throw std::runtime_error(
+                "Попытка взятия текста не из текстовой ячейки");
+        }
+        if (tag.length == kPooledText) {
+            return entry(payload)->str();
+        }
+        char buffer[kInlineText];
+        std::memcpy(buffer, &payload, sizeof(payload));
+        std::memcpy(buffer + sizeof(payload), tag.tail, sizeof(tag.tail));
+        return std::string(buffer, tag.length);
+    }
+
+    std::string_view getTextView()
+        const { // Метод для получения текста без копирования; короткий
+                // текст лежит в самой ячейке и действителен, пока она жива
+        if (tag.type != TEXT) {
+            throw std::runtime_error(
+                "Попытка взятия текста не из текстовой ячейки");
+        }
+        if (tag.length == kPooledText) {
+            return entry(payload)->str();
+        }
+        // Начало текста в payload, окончание - сразу за ним в tag.tail
+        return std::string_view(reinterpret_cast<const char*>(&payload),
+                                tag.length);
+    }
+
+    size_t textLength() const { // Метод, возвращающий длину текста ячейки
+        if (tag.type != TEXT) {
+            throw std::runtime_error(
+                "Попытка взятия текста не из текстовой ячейки");
+        }
+        if (tag.length == kPooledText) {
+            return entry(payload)->str().length();
+        }
+        return tag.length;
+    }
+
+    void setNumber(double num) { // Метод установки числа
+        release();
+        payload  = num;
+        tag      = Tag();
+        tag.type = NUMBER;
+    }
+
+    void setText(std::string_view txt) { // Метод установки текста
+        setText(txt, nullptr);
+    }
+
+    void setText(std::string_view   txt,
+                 StringPool::Cache* cache) { // Метод установки текста с
+                                             // поиском длинной строки
+                                             // сначала в кэше потока
+        release();
+        tag      = Tag();
+        tag.type = TEXT;
+        if (txt.length() <= kInlineText) {
+            char buffer[kInlineText] = {};
+            std::memcpy(buffer, txt.data(), txt.length());
+            std::memcpy(&payload, buffer, sizeof(payload));
+            std::memcpy(tag.tail, buffer + sizeof(payload), sizeof(tag.tail));
+            tag.length = static_cast<uint8_t>(txt.length());
+        } else {
+            payload    = pack(cache ? cache->intern(txt)
+                                    : StringPool::instance().intern(txt));
+            tag.length = kPooledText;
+        }
+    }
+
+    void clearCell() { // Метод очистки ячейки
+        release();
+        payload = 0.0;
+        tag     = Tag();
+    }
+
+    bool operator==(const Cell& other) const { // Сравнение значений ячеек
+        if (tag.type != other.tag.type) {
+            return false;
+        }
+        if (tag.type == NUMBER) {
+            return payload == other.payload;
+        }
+        // Пустые ячейки обнулены, а одинаковые строки пула - одна запись,
+        // поэтому остальные ячейки достаточно сравнить побайтно
+        return std::memcmp(&payload, &other.payload, sizeof(payload)) == 0 &&
+               std::memcmp(&tag, &other.tag, sizeof(tag)) == 0;
+    }
+
+    bool operator!=(const Cell& other) const { return !(*this == other); }
+
+    uint64_t hash() const { // Хеш значения: у равных ячеек хеши равны
+        uint64_t bits;
+        if (tag.type == NUMBER) {
+            double value = payload == 0 ? 0.0 : payload; // -0 == 0
+            std::memcpy(&bits, &value, sizeof(bits));
+            return mix(bits ^ NUMBER);
+        }
+        uint64_t tail;
+        std::memcpy(&bits, &payload, sizeof(bits));
+        std::memcpy(&tail, &tag, sizeof(tail));
+        return mix(bits ^ mix(tail));
+    }
+
+    static uint64_t mix(uint64_t x) { // Перемешивание битов (splitmix64)
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    struct Hash { // Хеш ячейки для неупорядоченных контейнеров
+        size_t operator()(const Cell& cell) const { return cell.hash(); }
+    };
+
+    std::string identify() const { return "Cell"; } // Метод идентификации
+
+private:
+    static bool pooled(const Tag& info) { // Лежит ли текст в пуле строк
+        return info.type == TEXT && info.length == kPooledText;
+    }
+
+    static double pack(const StringPool::Entry* text) { // Адрес записи пула
+                                                        // в виде payload
+        uint64_t bits = reinterpret_cast<uintptr_t>(text);
+        double   data;
+        std::memcpy(&data, &bits, sizeof(data));
+        return data;
+    }
+
+    static const StringPool::Entry* entry(double data) { // Запись пула по
+                                                         // payload
+        uint64_t bits;
+        std::memcpy(&bits, &data, sizeof(bits));
+        return reinterpret_cast<const StringPool::Entry*>(
+            static_cast<uintptr_t>(bits));
+    }
+
+    void retain() const { // Учет ячейки среди владельцев строки пула
+        if (pooled(tag)) {
+            StringPool::retain(entry(payload));
+        }
+    }
+
+    void release() { // Отказ ячейки от строки пула
+        if (pooled(tag)) {
+            StringPool::instance().release(entry(payload));
+        }
+    }
+};
+
+static_assert(sizeof(Cell) == 16, "Cell должна занимать 16 байт");
+
+// Класс MappedFile - Содержимое файла в памяти: файл отображается в память
+// (mmap), а там, где это недоступно, читается целиком.
+
+class MappedFile {
+private:
+    const char* begin;  // Начало содержимого
+    size_t      length; // Размер содержимого в байтах
+    std::string buffer; // Содержимое, если отображение недоступно
+#ifdef TABLE_POSIX_MMAP
+    void* mapping; // Отображенная область
+#endif
+
+public:
+    explicit MappedFile(const std::string& filename)
+        : begin(nullptr), length(0) { // Открытие файла
+#ifdef TABLE_POSIX_MMAP
+        mapping = MAP_FAILED;
+        int descriptor = ::open(filename.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::runtime_error("Не удалось открыть файл: " + filename);
+        }
+        struct stat info;
+        if (::fstat(descriptor, &info) == 0 && info.st_size > 0) {
+            length  = static_cast<size_t>(info.st_size);
+            mapping = ::mmap(
+                nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        }
+        ::close(descriptor);
+        if (mapping != MAP_FAILED) {
+            ::madvise(mapping, length, MADV_SEQUENTIAL);
+            begin = static_cast<const char*>(mapping);
+            return;
+        }
+#endif
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Не удалось открыть файл: " + filename);
+        }
+        buffer.assign(std::istreambuf_iterator<char>(file),
+                      std::istreambuf_iterator<char>());
+        begin  = buffer.data();
+        length = buffer.size();
+    }
+
+    ~MappedFile() { // Деструктор
+#ifdef TABLE_POSIX_MMAP
+        if (mapping != MAP_FAILED) {
+            ::munmap(mapping, length);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return begin; } // Начало содержимого
+    size_t      size() const { return length; } // Размер в байтах
+};
+
+// Класс Parallel - Запуск независимых задач в отдельных потоках с передачей
+// исключения из задачи вызывающему потоку.
+
+class Parallel {
+public:
+    static size_t hardwareThreads() { // Кол-во аппаратных потоков
+        size_t threads = std::thread::hardware_concurrency();
+        return threads > 0 ? threads : 1;
+    }
+
+    template <class Task>
+    static void run(size_t tasks, Task task) { // Выполнение task(0..tasks-1)
+        if (tasks == 1) {
+            task(0);
+            return;
+        }
+        std::vector<std::thread>        threads;
+        std::vector<std::exception_ptr> errors(tasks);
+        threads.reserve(tasks);
+        for (size_t k = 0; k < tasks; ++k) {
+            threads.emplace_back([&task, &errors, k]() {
+                try {
+                    task(k);
+                } catch (...) {
+                    errors[k] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+};
+
+// Класс Column - Столбец таблицы: последовательность блоков, в каждом из
+// которых ячейки хранятся по значению, но разделены на две половины, чтобы
+// числа блока лежали в памяти подряд. Блоки разного размера можно
+// присоединять друг к другу без копирования ячеек, а копия столбца делит
+// блоки с оригиналом, пока один из них не изменит блок. Блок с малым
+// кол-вом непустых ячеек хранится разреженно: только непустые ячейки и их
+// позиции, так что пустые ячейки памяти не занимают. Когда непустых ячеек
+// становится больше kSparseCells, блок становится плотным. Блоки столбца,
+// прочитанного из CSV-файла лениво, хранят только границы полей и
+// разбираются все сразу при первом обращении к любому из них.
+
+class Column {
+public:
+    static constexpr size_t kChunkRows = 65536; // Наибольшее кол-во ячеек
+                                                // блока
+    static constexpr size_t kSparseCells =
+        kChunkRows / 16; // Наибольшее кол-во непустых ячеек разреженного
+                         // блока
+
+    static const double* emptyNumbers() { // kChunkRows нулей: числа пустых
+                                          // ячеек
+        static const double numbers[kChunkRows] = {};
+        return numbers;
+    }
+    static const Cell::Tag* emptyTags() { // kChunkRows тегов пустых ячеек;
+                                          // участки из пропусков
+                                          // разреженных блоков указывают
+                                          // сюда
+        static const Cell::Tag tags[kChunkRows] = {};
+        return tags;
+    }
+
+    class Chunk { // Блок столбца: массивы, общие для копий таблицы,
+                  // участок отображенного в память файла или неразобранные
+                  // поля CSV-файла. Блок копируется при первом изменении,
+                  // если он общий или лежит в файле
+    private:
+        struct Storage {                    // Собственные массивы блока;
+                                            // владеют записями пула своих
+                                            // длинных строк
+            std::vector<double>    numbers; // Числа (первые 8 байт ячеек)
+            std::vector<Cell::Tag> tags;    // Тип и окончание текста ячеек
+            std::vector<uint32_t>  places;  // Позиции непустых ячеек
+                                            // (только у разреженного блока)
+            size_t                 count;   // Кол-во ячеек блока
+            size_t                 texts;   // Кол-во строк пула в массивах
+            bool                   sparse;  // Хранятся только непустые
+            std::atomic<uint64_t>  print;   // Отпечаток блока
+
+            Storage() : count(0), texts(0), sparse(true), print(0) {}
+            Storage(const Storage& other)
+                : numbers(other.numbers),
+                  tags(other.tags),
+                  places(other.places),
+                  count(other.count),
+                  texts(0),
+                  sparse(other.sparse),
+                  print(other.print.load()) {
+                for (size_t k = 0; other.texts > 0 && k < tags.size(); ++k) {
+                    keep(k);
+                }
+            }
+            ~Storage() {
+                for (size_t k = 0; texts > 0 && k < tags.size(); ++k) {
+                    drop(k);
+                }
+            }
+
+            void keep(size_t k) { // Учет строки пула на k-м месте массивов
+                if (Cell::pooled(tags[k])) {
+                    StringPool::retain(Cell::entry(numbers[k]));
+                    ++texts;
+                }
+            }
+
+            void drop(size_t k) { // Отказ от строки пула на k-м месте
+                if (Cell::pooled(tags[k])) {
+                    StringPool::instance().release(Cell::entry(numbers[k]));
+                    --texts;
+                }
+            }
+
+            void put(size_t k, const Cell& cell) { // Запись ячейки на k-е
+                                                   // место массивов
+                drop(k);
+                numbers[k] = cell.payload;
+                tags[k]    = cell.tag;
+                keep(k);
+            }
+        };
+
+    public:
+        struct RawField {      // Поле CSV-файла до разбора
+            uint64_t offset;   // Начало поля в файле (или в Raw::text)
+            uint32_t length;   // Длина поля; 0 - пустая ячейка
+            uint32_t unquoted; // Поле лежит в Raw::text: оно было в кавычках
+                               // и содержало удвоенные кавычки
+        };
+
+        class Mapping { // Отображенный в память файл таблицы со словарем
+                        // длинных строк. Открытие файла не читает ни
+                        // ячеек, ни словаря: блок проверяется при первом
+                        // обращении к его ячейкам, а строка словаря
+                        // переносится в пул при первом чтении ячейки с ней
+                        // и принадлежит словарю до закрытия файла
+        private:
+            typedef std::atomic<const StringPool::Entry*> Slot; // Запись
+                                                                // строки
+            static constexpr size_t kGroupBits = 12; // Записей в группе -
+                                                     // 2^kGroupBits
+            static constexpr size_t kGroupSize = size_t(1) << kGroupBits;
+
+            std::shared_ptr<const MappedFile> file;     // Содержимое файла
+            std::string                       name;     // Имя файла
+            const uint64_t*                   starts;   // Начала строк
+            const char*                       text;     // Строки подряд
+            uint64_t                          textSize; // Размер строк
+            uint64_t                          count;    // Кол-во строк
+            std::unique_ptr<std::atomic<Slot*>[]>
+                groups; // Группы записей строк; создаются при первом
+                        // обращении к их строкам
+            std::unique_ptr<std::atomic<bool>[]>
+                checked; // Проверенные блоки
+
+            Slot& slot(uint64_t k) const { // Запись k-й строки словаря
+                std::atomic<Slot*>& group = groups[k >> kGroupBits];
+                Slot* slots = group.load(std::memory_order_acquire);
+                if (!slots) {
+                    Slot* created = new Slot[kGroupSize]();
+                    if (group.compare_exchange_strong(
+                            slots, created, std::memory_order_acq_rel)) {
+                        slots = created;
+                    } else {
+                        delete[] created; // Группу создал другой поток
+                    }
+                }
+                return slots[k & (kGroupSize - 1)];
+            }
+
+            void fail() const { // Ошибка формата
+                throw std::runtime_error("Неверный формат файла таблицы: " +
+                                         name);
+            }
+
+            bool valid(const Cell::Tag& tag,
+                       double number) const { // Допустима ли ячейка
+                if (tag.type == Cell::EMPTY || tag.type == Cell::NUMBER) {
+                    return true;
+                }
+                if (tag.type != Cell::TEXT) {
+                    return false;
+                }
+                if (tag.length != Cell::kPooledText) {
+                    return tag.length <= Cell::kInlineText;
+                }
+                uint64_t id;
+                std::memcpy(&id, &number, sizeof(id));
+                return id < count;
+            }
+
+            void verify(size_t           k,
+                        const double*    numbers,
+                        const Cell::Tag* tags,
+                        size_t           n) const { // Проверка k-го блока:
+                                                    // служебные части ячеек
+                                                    // не должны выводить за
+                                                    // ячейку и словарь
+                for (size_t i = 0; i < n; ++i) {
+                    if (!valid(tags[i], numbers[i])) {
+                        fail();
+                    }
+                }
+                checked[k].store(true, std::memory_order_release);
+            }
+
+        public:
+            Mapping(std::shared_ptr<const MappedFile> mapping,
+                    const std::string&                filename,
+                    const uint64_t*                   offsets,
+                    const char*                       characters,
+                    uint64_t                          size,
+                    uint64_t                          total,
+                    size_t                            chunks)
+                : file(mapping),
+                  name(filename),
+                  starts(offsets),
+                  text(characters),
+                  textSize(size),
+                  count(total),
+                  groups(new std::atomic<Slot*>[(total + kGroupSize - 1) >>
+                                                kGroupBits]()),
+                  checked(new std::atomic<bool>[chunks]()) {}
+            ~Mapping() {
+                for (uint64_t g = 0; g < (count + kGroupSize - 1) >> kGroupBits;
+                     ++g) {
+                    Slot* slots = groups[g].load();
+                    for (size_t k = 0; slots && k < kGroupSize; ++k) {
+                        const StringPool::Entry* entry = slots[k].load();
+                        if (entry) {
+                            StringPool::instance().release(entry);
+                        }
+                    }
+                    delete[] slots;
+                }
+            }
+
+            Mapping(const Mapping&) = delete;
+            Mapping& operator=(const Mapping&) = delete;
+
+            void check(size_t           k,
+                       const double*    numbers,
+                       const Cell::Tag* tags,
+                       size_t           n) const { // Проверка k-го блока
+                                                   // при первом обращении
+                if (!checked[k].load(std::memory_order_acquire)) {
+                    verify(k, numbers, tags, n);
+                }
+            }
+
+            const StringPool::Entry* at(uint64_t k) const { // k-я строка
+                                                            // словаря
+                Slot&                    stored = slot(k);
+                const StringPool::Entry* entry =
+                    stored.load(std::memory_order_acquire);
+                if (entry) {
+                    return entry;
+                }
+                if (starts[k] > starts[k + 1] || starts[k + 1] > textSize) {
+                    fail();
+                }
+                entry = StringPool::instance().intern(std::string_view(
+                    text + starts[k], starts[k + 1] - starts[k]));
+                const StringPool::Entry* expected = nullptr;
+                if (!stored.compare_exchange_strong(
+                        expected, entry, std::memory_order_acq_rel)) {
+                    StringPool::instance().release(entry); // Строку уже
+                    entry = expected;                      // перенес другой
+                }                                          // поток
+                return entry;
+            }
+        };
+
+        class Raw { // Неразобранные поля столбца CSV-файла. При первом
+                    // обращении к любому блоку столбца весь столбец
+                    // разбирается за один проход (блоки - параллельно),
+                    // после чего поля и файл освобождаются
+        public:
+            typedef Cell (*Parse)(std::string_view,
+                                  StringPool::Cache*); // Разбор поля
+
+            std::shared_ptr<const MappedFile> file;   // Файл с полями
+            std::string                       text;   // Поля без удвоенных
+                                                      // кавычек
+            std::vector<RawField>             fields; // Поля по строкам
+
+            Raw(std::shared_ptr<const MappedFile> mapping, Parse parser)
+                : file(mapping), parse(parser), ready(false) {}
+
+            const Storage& at(size_t k) { // k-й блок разобранного столбца
+                if (!ready.load(std::memory_order_acquire)) {
+                    resolve();
+                }
+                return *storages[k];
+            }
+
+            std::shared_ptr<Storage> share(size_t k) { // k-й блок для
+                                                       // передачи во
+                                                       // владение
+                at(k);
+                return storages[k];
+            }
+
+        private:
+            Parse                                 parse;    // Разбор поля
+            std::atomic<bool>                     ready;    // Разобран ли
+            std::mutex                            mutex;    // Защищает разбор
+            std::vector<std::shared_ptr<Storage>> storages; // Блоки столбца
+
+            void resolve() { // Разбор всех полей столбца
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ready.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                size_t count   = (fields.size() + kChunkRows - 1) / kChunkRows;
+                size_t threads = std::min(Parallel::hardwareThreads(), count);
+                storages.resize(count);
+                Parallel::run(threads, [&](size_t t) {
+                    StringPool::Cache texts; // Недавние строки этого потока
+                    for (size_t k = t; k < count; k += threads) {
+                        storages[k] = convert(k, texts);
+                    }
+                });
+                std::vector<RawField>().swap(fields);
+                std::string().swap(text);
+                file.reset();
+                ready.store(true, std::memory_order_release);
+            }
+
+            std::shared_ptr<Storage> convert(
+                size_t             k,
+                StringPool::Cache& texts) const { // Разбор k-го блока
+                std::shared_ptr<Storage> data = std::make_shared<Storage>();
+                size_t from  = k * kChunkRows;
+                size_t count = std::min(kChunkRows, fields.size() - from);
+                data->numbers.resize(count);
+                data->tags.resize(count);
+                data->count  = count;
+                data->sparse = false;
+                uint64_t print = 0;
+                size_t   words = 0; // Поля, прочитанные как текст
+                for (size_t i = 0; i < count; ++i) {
+                    const RawField& field = fields[from + i];
+                    if (field.length == 0) {
+                        continue; // Пустая ячейка уже в массивах
+                    }
+                    const char* base = field.unquoted ? text.data()
+                                                      : file->data();
+                    Cell cell = parse(
+                        std::string_view(base + field.offset, field.length),
+                        &texts);
+                    data->put(i, cell);
+                    print ^= fingerprint(cell, i);
+                    words += cell.getType() == Cell::TEXT;
+                }
+                Stats::add(Stats::READ_TEXT_FIELDS, words);
+                data->print = print;
+                return data;
+            }
+        };
+
+    private:
+        std::shared_ptr<Storage>          storage;     // Массивы блока
+        std::shared_ptr<const Mapping> file;        // Отображенный файл
+        const double*                  fileNumbers; // Числа в файле
+        const Cell::Tag*               fileTags;    // Теги в файле
+        size_t                         fileCount;   // Кол-во ячеек
+        uint64_t                       filePrint;   // Отпечаток из файла
+        std::shared_ptr<Raw>           raw;         // Неразобранный столбец
+                                                    // CSV-файла
+        size_t index; // Номер блока в столбце raw или в файле
+
+        const Storage& data() const {
+            return raw ? raw->at(index) : *storage;
+        } // Массивы блока (блок CSV-файла разбирается при первом обращении)
+        bool sparse() const {
+            return !file && data().sparse;
+        } // Разрежен ли блок
+        const double* numbers() const {
+            if (file) {
+                file->check(index, fileNumbers, fileTags, fileCount);
+                return fileNumbers;
+            }
+            return data().numbers.data();
+        } // Числа блока подряд (у разреженного - только непустых)
+        const Cell::Tag* tags() const {
+            if (file) {
+                file->check(index, fileNumbers, fileTags, fileCount);
+                return fileTags;
+            }
+            return data().tags.data();
+        } // Теги блока подряд (у разреженного - только непустых)
+
+        size_t find(size_t i) const { // Место i-й ячейки в массивах
+                                      // разреженного блока (places.size(),
+                                      // если ячейка пуста)
+            const std::vector<uint32_t>& places = storage->places;
+            auto at = std::lower_bound(places.begin(), places.end(), i);
+            return at != places.end() && *at == i ? at - places.begin()
+                                                  : places.size();
+        }
+
+        void mark(size_t i, const Cell& cell) { // Учет ячейки в отпечатке;
+                                                // повторный учет убирает ее
+            storage->print.fetch_xor(fingerprint(cell, i),
+                                     std::memory_order_relaxed);
+        }
+
+        void own() { // Получение собственной копии массивов перед записью
+            if (raw) { // Разобранный блок CSV-файла общий со столбцом raw
+                storage = raw->share(index);
+                raw.reset();
+            }
+            if (file) {
+                std::shared_ptr<Storage> copy = std::make_shared<Storage>();
+                copy->numbers.resize(fileCount);
+                copy->tags.resize(fileCount);
+                for (size_t i = 0; i < fileCount; ++i) {
+                    copy->put(i, get(i));
+                }
+                copy->count  = fileCount;
+                copy->sparse = false;
+                copy->print  = filePrint;
+                storage      = copy;
+                file.reset();
+            } else if (storage.use_count() > 1) { // Блок есть в других копиях
+                storage = std::make_shared<Storage>(*storage);
+            }
+        }
+
+        void densify() { // Переход разреженного блока к плотному хранению
+            Storage&               data = *storage;
+            std::vector<double>    numbers(data.count, 0.0);
+            std::vector<Cell::Tag> tags(data.count, Cell::Tag());
+            for (size_t k = 0; k < data.places.size(); ++k) {
+                numbers[data.places[k]] = data.numbers[k];
+                tags[data.places[k]]    = data.tags[k];
+            }
+            data.numbers.swap(numbers);
+            data.tags.swap(tags);
+            std::vector<uint32_t>().swap(data.places);
+            data.sparse = false;
+        }
+
+    public:
+        Chunk()
+            : storage(std::make_shared<Storage>()),
+              fileNumbers(nullptr),
+              fileTags(nullptr),
+              fileCount(0),
+              filePrint(0),
+              index(0) {}
+        Chunk(std::shared_ptr<const Mapping> mapping,
+              size_t                         k,
+              const double*                  numbers,
+              const Cell::Tag*               tags,
+              size_t                         count,
+              uint64_t                       print)
+            : file(mapping),
+              fileNumbers(numbers),
+              fileTags(tags),
+              fileCount(count),
+              filePrint(print),
+              index(k) {} // k-й блок над участком файла
+        Chunk(std::shared_ptr<Raw> fields, size_t k)
+            : fileNumbers(nullptr),
+              fileTags(nullptr),
+              fileCount(std::min(kChunkRows,
+                                 fields->fields.size() - k * kChunkRows)),
+              filePrint(0),
+              raw(fields),
+              index(k) {} // k-й блок неразобранного столбца CSV-файла
+
+        size_t size() const {
+            return file || raw ? fileCount : storage->count;
+        } // Кол-во ячеек блока
+
+        uint64_t print() const {
+            return file ? filePrint
+                        : data().print.load(std::memory_order_relaxed);
+        } // Отпечаток блока
+
+        Cell::TypeCell getType(size_t i) const { // Тип i-й ячейки блока
+            if (sparse()) {
+                size_t k = find(i);
+                return k < storage->places.size() ? storage->tags[k].type
+                                                  : Cell::EMPTY;
+            }
+            return tags()[i].type;
+        }
+
+        double getNumber(size_t i) const { // Первые 8 байт i-й ячейки
+            if (sparse()) {
+                size_t k = find(i);
+                return k < storage->places.size() ? storage->numbers[k] : 0.0;
+            }
+            return numbers()[i];
+        }
+
+        Cell get(size_t i) const { // Значение i-й ячейки блока
+            if (sparse()) {
+                size_t k = find(i);
+                return k < storage->places.size()
+                           ? Cell(storage->numbers[k], storage->tags[k])
+                           : Cell();
+            }
+            const Cell::Tag& tag = tags()[i];
+            if (file && Cell::pooled(tag)) { // Номер строки словаря файла
+                uint64_t id;
+                std::memcpy(&id, &fileNumbers[i], sizeof(id));
+                return Cell(Cell::pack(file->at(id)), tag);
+            }
+            return Cell(numbers()[i], tag);
+        }
+
+        template <class Visitor>
+        void forEachSlice(size_t  from,
+                          size_t  to,
+                          Visitor visit) const { // Обход ячеек [from, to)
+                                                 // непрерывными участками;
+                                                 // пропуски разреженного
+                                                 // блока - участки пустых
+                                                 // ячеек из emptyTags()
+            if (!sparse()) {
+                visit(numbers() + from, tags() + from, to - from);
+                return;
+            }
+            const std::vector<uint32_t>& places = storage->places;
+            size_t k = std::lower_bound(places.begin(), places.end(), from) -
+                       places.begin();
+            while (from < to) {
+                if (k == places.size() || places[k] >= to) { // Хвост пуст
+                    visit(emptyNumbers(), emptyTags(), to - from);
+                    return;
+                }
+                if (places[k] > from) { // Пропуск до следующей ячейки
+                    visit(emptyNumbers(), emptyTags(), places[k] - from);
+                    from = places[k];
+                }
+                size_t run = k; // Ячейки на соседних позициях идут подряд
+                while (run < places.size() && places[run] < to &&
+                       places[run] == from + (run - k)) {
+                    ++run;
+                }
+                visit(storage->numbers.data() + k,
+                      storage->tags.data() + k,
+                      run - k);
+                from += run - k;
+                k = run;
+            }
+        }
+
+        void set(size_t i, const Cell& cell) { // Установка значения ячейки
+            own();
+            mark(i, get(i));
+            mark(i, cell);
+            Storage& data = *storage;
+            if (!data.sparse) {
+                data.put(i, cell);
+                return;
+            }
+            std::vector<uint32_t>& places = data.places;
+            size_t k = std::lower_bound(places.begin(), places.end(), i) -
+                       places.begin();
+            if (k < places.size() && places[k] == i) { // Ячейка уже хранится
+                if (cell.tag.type == Cell::EMPTY) {
+                    data.drop(k);
+                    places.erase(places.begin() + k);
+                    data.numbers.erase(data.numbers.begin() + k);
+                    data.tags.erase(data.tags.begin() + k);
+                } else {
+                    data.put(k, cell);
+                }
+                return;
+            }
+            if (cell.tag.type == Cell::EMPTY) {
+                return;
+            }
+            places.insert(places.begin() + k, static_cast<uint32_t>(i));
+            data.numbers.insert(data.numbers.begin() + k, cell.payload);
+            data.tags.insert(data.tags.begin() + k, cell.tag);
+            data.keep(k);
+            if (data.places.size() > kSparseCells) {
+                densify();
+            }
+        }
+
+        void push(const Cell& cell) { // Добавление ячейки в конец блока
+            own();
+            Storage& data = *storage;
+            mark(data.count, cell);
+            if (!data.sparse || cell.tag.type != Cell::EMPTY) {
+                if (data.sparse) {
+                    data.places.push_back(static_cast<uint32_t>(data.count));
+                }
+                data.numbers.push_back(cell.payload);
+                data.tags.push_back(cell.tag);
+                data.keep(data.tags.size() - 1);
+            }
+            ++data.count;
+            if (data.sparse && data.places.size() > kSparseCells) {
+                densify();
+            }
+        }
+
+        void makeDense() { // Переход к собственному плотному хранению
+            own();
+            if (storage->sparse) {
+                densify();
+            }
+        }
+
+        void pushEmpty(size_t n) { // Добавление n пустых ячеек
+            own();
+            Storage& data = *storage;
+            if (!data.sparse) {
+                data.numbers.resize(data.count + n, 0.0);
+                data.tags.resize(data.count + n, Cell::Tag());
+            }
+            data.count += n;
+        }
+    };
+
+private:
+    std::vector<Chunk>  chunks; // Блоки столбца
+    std::vector<size_t> starts; // Номер первой ячейки каждого блока и
+                                // общее кол-во ячеек в конце
+
+    size_t locate(size_t i) const { // Номер блока, содержащего i-ю ячейку
+        if (chunks.size() == 1) {
+            return 0;
+        }
+        return std::upper_bound(starts.begin(), starts.end(), i) -
+               starts.begin() - 1;
+    }
+
+    Chunk& lastChunk() { // Блок, в который можно дописать ячейку
+        if (chunks.empty() || chunks.back().size() == kChunkRows) {
+            chunks.push_back(Chunk());
+            starts.push_back(starts.back());
+        }
+        return chunks.back();
+    }
+
+public:
+    explicit Column(size_t rows = 0) : starts(1, 0) { pushEmpty(rows); }
+
+    static uint64_t fingerprint(const Cell& cell,
+                                size_t position) { // Хеш ячейки на позиции
+                                                   // блока; у пустой - 0
+        if (cell.tag.type == Cell::EMPTY) {
+            return 0;
+        }
+        uint64_t bits = 0;
+        if (cell.tag.type == Cell::NUMBER) {
+            double value = cell.payload == 0 ? 0.0 : cell.payload; // -0 == 0
+            std::memcpy(&bits, &value, sizeof(bits));
+        } else if (cell.tag.length == Cell::kPooledText) {
+            bits = Cell::entry(cell.payload)->hash(); // По содержимому строки
+        } else {
+            uint64_t tail;
+            std::memcpy(&bits, &cell.payload, sizeof(bits));
+            std::memcpy(&tail, &cell.tag, sizeof(tail));
+            bits ^= Cell::mix(tail);
+        }
+        return Cell::mix(Cell::mix(bits ^ cell.tag.type) + position);
+    }
+
+    static bool same(const Cell& a,
+                     const Cell& b) { // Совпадают ли ячейки при сравнении
+                                      // столбцов; как и у отпечатков, -0
+                                      // равен 0, а NaN равен NaN с теми же
+                                      // битами
+        if (a == b) {
+            return true;
+        }
+        return a.tag.type == Cell::NUMBER && b.tag.type == Cell::NUMBER &&
+               std::memcmp(&a.payload, &b.payload, sizeof(a.payload)) == 0;
+    }
+
+    size_t chunkCount() const { return chunks.size(); } // Кол-во блоков
+    size_t chunkStart(size_t k) const {
+        return starts[k];
+    } // Первая ячейка k-го блока (k = chunkCount() - конец столбца)
+    uint64_t chunkPrint(size_t k) const {
+        return chunks[k].print();
+    } // Отпечаток k-го блока
+
+    bool sameLayout(const Column& other)
+        const { // Совпадают ли границы блоков двух столбцов
+        return starts == other.starts;
+    }
+
+    size_t size() const { return starts.back(); } // Кол-во ячеек
+
+    Cell::TypeCell getType(size_t i) const { // Тип i-й ячейки
+        size_t k = locate(i);
+        return chunks[k].getType(i - starts[k]);
+    }
+
+    double getNumber(size_t i) const {
+        size_t k = locate(i);
+        return chunks[k].getNumber(i - starts[k]);
+    }
+
+    Cell get(size_t i) const { // Значение i-й ячейки
+        size_t k = locate(i);
+        return chunks[k].get(i - starts[k]);
+    }
+
+    void set(size_t i, const Cell& cell) { // Установка значения ячейки
+        size_t k = locate(i);
+        chunks[k].set(i - starts[k], cell);
+    }
+
+    void makeDense(size_t i) { // Собственное плотное хранение блока с i-й
+                               // ячейкой
+        chunks[locate(i)].makeDense();
+    }
+
+    void push(const Cell& cell) { // Добавление ячейки в конец столбца
+        lastChunk().push(cell);
+        starts.back()++;
+    }
+
+    void pushEmpty(size_t count) { // Добавление count пустых ячеек
+        while (count > 0) {
+            Chunk& chunk = lastChunk();
+            size_t n     = std::min(count, kChunkRows - chunk.size());
+            chunk.pushEmpty(n);
+            starts.back() += n;
+            count -= n;
+        }
+    }
+
+    void pushChunk(Chunk&& chunk) { // Присоединение готового блока
+        if (chunk.size() > 0) {
+            starts.push_back(starts.back() + chunk.size());
+            chunks.push_back(std::move(chunk));
+        }
+    }
+
+    void append(Column&& other) { // Присоединение блоков другого столбца
+        for (Chunk& chunk : other.chunks) {
+            pushChunk(std::move(chunk));
+        }
+        other.chunks.clear();
+        other.starts.assign(1, 0);
+    }
+
+    template <class Visitor>
+    void forEachSlice(size_t  from,
+                      size_t  to,
+                      Visitor visit) const { // Обход ячеек [from, to)
+                                             // непрерывными участками
+        for (size_t k = from < to ? locate(from) : 0; from < to; ++k) {
+            size_t offset = from - starts[k];
+            size_t n      = std::min(to, starts[k + 1]) - from;
+            chunks[k].forEachSlice(offset, offset + n, visit);
+            from += n;
+        }
+    }
+
+    std::shared_ptr<Cell> view(
+        size_t i) const { // Ячейка в виде отдельного объекта Cell
+        Stats::add(Stats::CELL_ALLOCATIONS);
+        return std::make_shared<Cell>(get(i));
+    }
+};
+
+// Класс RangeView - Прямоугольный диапазон таблицы без копирования ячеек:
+// границы диапазона и указатель на столбцы таблицы. Каждый столбец
+// диапазона обходится непрерывными участками памяти. Представление
+// действительно, пока таблица не изменена.
+
+class RangeView {
+private:
+    const Column* first;    // Первый столбец диапазона
+    size_t        rowFrom;  // Первая строка диапазона
+    size_t        rowCount; // Кол-во строк диапазона
+    size_t        colCount; // Кол-во столбцов диапазона
+
+public:
+    RangeView()
+        : first(nullptr),
+          rowFrom(0),
+          rowCount(0),
+          colCount(0) {} // Конструктор пустого диапазона
+    RangeView(const Column* columns,
+              size_t        fromRow,
+              size_t        rows,
+              size_t        cols) // Конструктор инициализации
+        : first(columns), rowFrom(fromRow), rowCount(rows), colCount(cols) {}
+
+    size_t rows() const { return rowCount; }    // Кол-во строк
+    size_t columns() const { return colCount; } // Кол-во столбцов
+    size_t size() const {
+        return rowCount * colCount;
+    } // Кол-во ячеек диапазона
+    bool empty() const { return size() == 0; }
+
+    template <class Visitor>
+    void forEachSlice(size_t j, Visitor visit) const {
+        first[j].forEachSlice(rowFrom, rowFrom + rowCount, visit);
+    } // Обход j-го столбца диапазона непрерывными участками
+
+    Cell::TypeCell getType(size_t i, size_t j) const {
+        return first[j].getType(rowFrom + i);
+    } // Тип ячейки (i, j) относительно начала диапазона
+
+    Cell get(size_t i, size_t j) const {
+        return first[j].get(rowFrom + i);
+    } // Ячейка (i, j) относительно начала диапазона
+};
+
+// Класс Kernels - Ядра свёртки непрерывных массивов чисел: сумма,
+// произведение и сумма с компенсацией ошибок округления (по Кэхэну,
+// отдельно в каждой полосе вектора), а также ядро сравнения чисел участка
+// столбца с границей. Реализация (AVX-512, AVX2, SSE2 или скалярная)
+// выбирается один раз по возможностям процессора.
+
+class Kernels {
+public:
+    enum Comparison { // Сравнения числа с границей
+        LESS,
+        LESS_EQUAL,
+        GREATER,
+        GREATER_EQUAL,
+        EQUAL,
+        NOT_EQUAL
+    };
+
+    typedef double (*Reduce)(const double* values, size_t n); // Ядро свёртки
+    typedef void (*Compare)(const double*    values,
+                            const Cell::Tag* tags,
+                            size_t           n,
+                            Comparison       comparison,
+                            double           bound,
+                            uint8_t* mask); // Ядро сравнения: mask[i] = 1,
+                                            // если i-я ячейка - число,
+                                            // удовлетворяющее сравнению
+
+    Reduce      sum;            // Сумма
+    Reduce      product;        // Произведение
+    Reduce      compensatedSum; // Сумма с компенсацией
+    Compare     compare;        // Сравнение с границей
+    const char* name;           // Название набора инструкций
+
+    static const Kernels& instance() { // Ядра для текущего процессора
+        static const Kernels kernels = detect();
+        return kernels;
+    }
+
+    static void kahanAdd(double& total,
+                         double& compensation,
+                         double  value) { // Шаг суммирования Кэхэна
+        double corrected = value - compensation;
+        double next      = total + corrected;
+        compensation     = (next - total) - corrected;
+        total            = next;
+    }
+
+private:
+    static Kernels detect() { // Выбор ядер по возможностям процессора
+#ifdef TABLE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return {avx512Sum,
+                    avx512Product,
+                    avx512CompensatedSum,
+                    avx2Compare,
+                    "avx512"};
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return {avx2Sum, avx2Product, avx2CompensatedSum, avx2Compare,
+                    "avx2"};
+        }
+        return {sse2Sum, sse2Product, sse2CompensatedSum, scalarCompare,
+                "sse2"};
+#else
+        return {scalarSum,
+                scalarProduct,
+                scalarCompensatedSum,
+                scalarCompare,
+                "scalar"};
+#endif
+    }
+
+    template <class Test>
+    static void scalarMatch(const double*    values,
+                            const Cell::Tag* tags,
+                            size_t           n,
+                            Test             test,
+                            uint8_t*         mask) { // Сравнение по одной
+                                                     // ячейке
+        for (size_t i = 0; i < n; ++i) {
+            mask[i] = tags[i].type == Cell::NUMBER && test(values[i]);
+        }
+    }
+
+    static void scalarCompare(const double*    values,
+                              const Cell::Tag* tags,
+                              size_t           n,
+                              Comparison       comparison,
+                              double           bound,
+                              uint8_t*         mask) {
+        switch (comparison) {
+            case LESS:
+                return scalarMatch(
+                    values, tags, n, [bound](double x) { return x < bound; },
+                    mask);
+            case LESS_EQUAL:
+                return scalarMatch(
+                    values, tags, n, [bound](double x) { return x <= bound; },
+                    mask);
+            case GREATER:
+                return scalarMatch(
+                    values, tags, n, [bound](double x) { return x > bound; },
+                    mask);
+            case GREATER_EQUAL:
+                return scalarMatch(
+                    values, tags, n, [bound](double x) { return x >= bound; },
+                    mask);
+            case EQUAL:
+                return scalarMatch(
+                    values, tags, n, [bound](double x) { return x == bound; },
+                    mask);
+            case NOT_EQUAL:
+                return scalarMatch(
+                    values, tags, n, [bound](double x) { return x != bound; },
+                    mask);
+        }
+        throw std::logic_error("Неверный тип сравнения.");
+    }
+
+    static double scalarSum(const double* values, size_t n) {
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            total += values[i];
+        }
+        return total;
+    }
+
+    static double scalarProduct(const double* values, size_t n) {
+        double result = 1.0;
+        for (size_t i = 0; i < n; ++i) {
+            result *= values[i];
+        }
+        return result;
+    }
+
+    static double scalarCompensatedSum(const double* values, size_t n) {
+        double total = 0.0, compensation = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            kahanAdd(total, compensation, values[i]);
+        }
+        return total;
+    }
+
+    static double finishLanes(const double* lanes,
+                              const double* compensations,
+                              size_t        width,
+                              const double* tail,
+                              size_t        n) { // Сведение полос и хвоста
+        double total = 0.0, compensation = 0.0;
+        for (size_t k = 0; k < width; ++k) {
+            kahanAdd(total, compensation, lanes[k]);
+            kahanAdd(total, compensation, -compensations[k]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            kahanAdd(total, compensation, tail[i]);
+        }
+        return total;
+    }
+
+#ifdef TABLE_X86_KERNELS
+    static double sse2Sum(const double* values, size_t n) {
+        __m128d first = _mm_setzero_pd(), second = _mm_setzero_pd();
+        size_t  i     = 0;
+        for (; i + 4 <= n; i += 4) {
+            first  = _mm_add_pd(first, _mm_loadu_pd(values + i));
+            second = _mm_add_pd(second, _mm_loadu_pd(values + i + 2));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(first, second));
+        return lanes[0] + lanes[1] + scalarSum(values + i, n - i);
+    }
+
+    static double sse2Product(const double* values, size_t n) {
+        __m128d first = _mm_set1_pd(1.0), second = _mm_set1_pd(1.0);
+        size_t  i     = 0;
+        for (; i + 4 <= n; i += 4) {
+            first  = _mm_mul_pd(first, _mm_loadu_pd(values + i));
+            second = _mm_mul_pd(second, _mm_loadu_pd(values + i + 2));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_mul_pd(first, second));
+        return lanes[0] * lanes[1] * scalarProduct(values + i, n - i);
+    }
+
+    static double sse2CompensatedSum(const double* values, size_t n) {
+        __m128d total = _mm_setzero_pd(), compensation = _mm_setzero_pd();
+        size_t  i     = 0;
+        for (; i + 2 <= n; i += 2) {
+            __m128d corrected =
+                _mm_sub_pd(_mm_loadu_pd(values + i), compensation);
+            __m128d next = _mm_add_pd(total, corrected);
+            compensation = _mm_sub_pd(_mm_sub_pd(next, total), corrected);
+            total        = next;
+        }
+        double lanes[2], compensations[2];
+        _mm_storeu_pd(lanes, total);
+        _mm_storeu_pd(compensations, compensation);
+        return finishLanes(lanes, compensations, 2, values + i, n - i);
+    }
+
+    __attribute__((target("avx2"))) static double avx2Sum(
+        const double* values, size_t n) {
+        __m256d acc[4] = {_mm256_setzero_pd(),
+                          _mm256_setzero_pd(),
+                          _mm256_setzero_pd(),
+                          _mm256_setzero_pd()};
+        size_t  i      = 0;
+        for (; i + 16 <= n; i += 16) {
+            for (int k = 0; k < 4; ++k) {
+                acc[k] = _mm256_add_pd(acc[k],
+                                       _mm256_loadu_pd(values + i + 4 * k));
+            }
+        }
+        __m256d joined =
+            _mm256_add_pd(_mm256_add_pd(acc[0], acc[1]),
+                          _mm256_add_pd(acc[2], acc[3]));
+        double lanes[4];
+        _mm256_storeu_pd(lanes, joined);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+               scalarSum(values + i, n - i);
+    }
+
+    __attribute__((target("avx2"))) static double avx2Product(
+        const double* values, size_t n) {
+        __m256d first = _mm256_set1_pd(1.0), second = _mm256_set1_pd(1.0);
+        size_t  i     = 0;
+        for (; i + 8 <= n; i += 8) {
+            first  = _mm256_mul_pd(first, _mm256_loadu_pd(values + i));
+            second = _mm256_mul_pd(second, _mm256_loadu_pd(values + i + 4));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_mul_pd(first, second));
+        return (lanes[0] * lanes[1]) * (lanes[2] * lanes[3]) *
+               scalarProduct(values + i, n - i);
+    }
+
+    __attribute__((target("avx2"))) static double avx2CompensatedSum(
+        const double* values, size_t n) {
+        __m256d total = _mm256_setzero_pd(), compensation = _mm256_setzero_pd();
+        size_t  i     = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d corrected =
+                _mm256_sub_pd(_mm256_loadu_pd(values + i), compensation);
+            __m256d next = _mm256_add_pd(total, corrected);
+            compensation = _mm256_sub_pd(_mm256_sub_pd(next, total), corrected);
+            total        = next;
+        }
+        double lanes[4], compensations[4];
+        _mm256_storeu_pd(lanes, total);
+        _mm256_storeu_pd(compensations, compensation);
+        return finishLanes(lanes, compensations, 4, values + i, n - i);
+    }
+
+    template <int kPredicate>
+    __attribute__((target("avx2"))) static void avx2Match(
+        const double*    values,
+        const Cell::Tag* tags,
+        size_t           n,
+        Comparison       comparison,
+        double           bound,
+        uint8_t*         mask) { // Сравнение четырех ячеек за шаг: тип
+                                 // ячейки - старший байт ее тега
+        static_assert(sizeof(Cell::Tag) == 8, "Тег должен занимать 8 байт");
+        const __m256d limit  = _mm256_set1_pd(bound);
+        const __m256i number = _mm256_set1_epi64x(Cell::NUMBER);
+        size_t        i      = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d hit = _mm256_cmp_pd(
+                _mm256_loadu_pd(values + i), limit, kPredicate);
+            __m256i types = _mm256_srli_epi64(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags + i)),
+                56);
+            __m256d typed =
+                _mm256_castsi256_pd(_mm256_cmpeq_epi64(types, number));
+            int bits = _mm256_movemask_pd(_mm256_and_pd(hit, typed));
+            for (int k = 0; k < 4; ++k) {
+                mask[i + k] = (bits >> k) & 1;
+            }
+        }
+        scalarCompare(values + i, tags + i, n - i, comparison, bound, mask + i);
+    }
+
+    __attribute__((target("avx2"))) static void avx2Compare(
+        const double*    values,
+        const Cell::Tag* tags,
+        size_t           n,
+        Comparison       comparison,
+        double           bound,
+        uint8_t*         mask) {
+        switch (comparison) {
+            case LESS:
+                return avx2Match<_CMP_LT_OQ>(
+                    values, tags, n, comparison, bound, mask);
+            case LESS_EQUAL:
+                return avx2Match<_CMP_LE_OQ>(
+                    values, tags, n, comparison, bound, mask);
+            case GREATER:
+                return avx2Match<_CMP_GT_OQ>(
+                    values, tags, n, comparison, bound, mask);
+            case GREATER_EQUAL:
+                return avx2Match<_CMP_GE_OQ>(
+                    values, tags, n, comparison, bound, mask);
+            case EQUAL:
+                return avx2Match<_CMP_EQ_OQ>(
+                    values, tags, n, comparison, bound, mask);
+            case NOT_EQUAL:
+                return avx2Match<_CMP_NEQ_UQ>(
+                    values, tags, n, comparison, bound, mask);
+        }
+        throw std::logic_error("Неверный тип сравнения.");
+    }
+
+    __attribute__((target("avx512f"))) static double avx512Sum(
+        const double* values, size_t n) {
+        __m512d first = _mm512_setzero_pd(), second = _mm512_setzero_pd();
+        size_t  i     = 0;
+        for (; i + 16 <= n; i += 16) {
+            first  = _mm512_add_pd(first, _mm512_loadu_pd(values + i));
+            second = _mm512_add_pd(second, _mm512_loadu_pd(values + i + 8));
+        }
+        double lanes[8];
+        _mm512_storeu_pd(lanes, _mm512_add_pd(first, second));
+        return scalarSum(lanes, 8) + scalarSum(values + i, n - i);
+    }
+
+    __attribute__((target("avx512f"))) static double avx512Product(
+        const double* values, size_t n) {
+        __m512d first = _mm512_set1_pd(1.0), second = _mm512_set1_pd(1.0);
+        size_t  i     = 0;
+        for (; i + 16 <= n; i += 16) {
+            first  = _mm512_mul_pd(first, _mm512_loadu_pd(values + i));
+            second = _mm512_mul_pd(second, _mm512_loadu_pd(values + i + 8));
+        }
+        double lanes[8];
+        _mm512_storeu_pd(lanes, _mm512_mul_pd(first, second));
+        return scalarProduct(lanes, 8) * scalarProduct(values + i, n - i);
+    }
+
+    __attribute__((target("avx512f"))) static double avx512CompensatedSum(
+        const double* values, size_t n) {
+        __m512d total = _mm512_setzero_pd(), compensation = _mm512_setzero_pd();
+        size_t  i     = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m512d corrected =
+                _mm512_sub_pd(_mm512_loadu_pd(values + i), compensation);
+            __m512d next = _mm512_add_pd(total, corrected);
+            compensation = _mm512_sub_pd(_mm512_sub_pd(next, total), corrected);
+            total        = next;
+        }
+        double lanes[8], compensations[8];
+        _mm512_storeu_pd(lanes, total);
+        _mm512_storeu_pd(compensations, compensation);
+        return finishLanes(lanes, compensations, 8, values + i, n - i);
+    }
+#endif
+};
+
+// Класс FormulaCell - Формула: диапазон ячеек (адреса первой и последней
+// ячейки) и операция над диапазоном (сумма, произведение, среднее значение),
+// метод вывода результата операции (или ошибки, если расчёт невозможен).
+// Формула - отдельный объект, а не разновидность ячейки: её результат
+// записывается в обычную числовую ячейку.
+
+class FormulaCell {
+public:
+    enum Operation { SUM, PRODUCT, AVERAGE }; // Типы операций
+    enum Precision { FAST, COMPENSATED };     // Режимы суммирования
+
+private:
+    std::vector<Cell> range;         // Диапазон ячеек
+    RangeView         view;          // Диапазон таблицы без копирования
+    Operation         operationType; // Тип операции
+    Precision         precision;     // Режим суммирования
+    Cell::TypeCell    type;          // Тип результата формулы
+
+public:
+    FormulaCell()
+        : operationType(SUM),
+          precision(FAST),
+          type(Cell::EMPTY) {} // Конструктор по-умолчанию
+    FormulaCell(const std::vector<Cell>& cells,
+                Operation                op) // Конструктор инициализации
+        : range(cells),
+          operationType(op),
+          precision(FAST),
+          type(Cell::NUMBER) {}
+    FormulaCell(const std::vector<std::shared_ptr<Cell> >& cells,
+                Operation op) // Конструктор из указателей на ячейки
+        : operationType(op), precision(FAST), type(Cell::NUMBER) {
+        range.reserve(cells.size());
+        for (const auto& cell : cells) {
+            range.push_back(*cell);
+        }
+    }
+    FormulaCell(const RangeView& cells,
+                Operation        op,
+                Precision        mode = FAST) // Конструктор над диапазоном
+                                              // таблицы
+        : view(cells), operationType(op), precision(mode), type(Cell::NUMBER) {
+    }
+
+    Cell::TypeCell getType() const {
+        return type;
+    } // Метод, возвращающий тип результата формулы
+
+    std::vector<Cell> getRange() const { // Метод, возрваращающий диапозон ячеек
+        if (view.empty()) {
+            return range;
+        }
+        std::vector<Cell> cells;
+        cells.reserve(view.size());
+        for (size_t i = 0; i < view.rows(); ++i) {
+            for (size_t j = 0; j < view.columns(); ++j) {
+                cells.push_back(view.get(i, j));
+            }
+        }
+        return cells;
+    }
+
+    const RangeView& getView() const {
+        return view;
+    } // Метод, возвращающий диапазон таблицы
+
+    class Accumulator { // Накопитель результата операции над числами
+    private:
+        Operation op;           // Выполняемая операция
+        Precision precision;    // Режим суммирования
+        double    total;        // Промежуточный результат
+        double    compensation; // Накопленная ошибка округления суммы
+        size_t    count;        // Кол-во учтенных чисел
+
+    public:
+        explicit Accumulator(Operation oper, Precision mode = FAST)
+            : op(oper),
+              precision(mode),
+              total(oper == PRODUCT ? 1.0 : 0.0),
+              compensation(0.0),
+              count(0) {}
+
+        void check(Cell::TypeCell type) const { // Проверка типа ячейки
+            if (type == Cell::NUMBER) {
+                return;
+            }
+            switch (op) {
+                case SUM:
+                    throw std::runtime_error(
+                        "Все ячейки должны быть числовыми для операции "
+                        "суммы.");
+                case PRODUCT:
+                    throw std::runtime_error(
+                        "Все ячейки должны быть числовыми для операции "
+                        "произведения.");
+                case AVERAGE:
+                    throw std::runtime_error(
+                        "Все ячейки должны быть числовыми для операции "
+                        "среднего.");
+            }
+            throw std::logic_error("Неверный тип операции.");
+        }
+
+        void add(double value) { // Учет одного числа
+            if (op == PRODUCT) {
+                total *= value;
+            } else if (precision == COMPENSATED) {
+                Kernels::kahanAdd(total, compensation, value);
+            } else {
+                total += value;
+            }
+            ++count;
+        }
+
+        double fold(const double* values,
+                    size_t        n) const { // Свертка массива чисел ядром
+            const Kernels& kernels = Kernels::instance();
+            if (op == PRODUCT) {
+                return kernels.product(values, n);
+            }
+            return precision == COMPENSATED ? kernels.compensatedSum(values, n)
+                                            : kernels.sum(values, n);
+        }
+
+        void addFolded(double folded,
+                       size_t n) { // Учет свертки n чисел, полученной fold
+            if (op == PRODUCT) {
+                total *= folded;
+            } else if (precision == COMPENSATED) {
+                Kernels::kahanAdd(total, compensation, folded);
+            } else {
+                total += folded;
+            }
+            count += n;
+        }
+
+        void add(const double* values,
+                 size_t        n) { // Учет непрерывного массива чисел
+            addFolded(fold(values, n), n);
+        }
+
+        void add(const RangeView& view) { // Учет всех ячеек диапазона
+            for (size_t j = 0; j < view.columns(); ++j) {
+                view.forEachSlice(j,
+                                  [this](const double*    numbers,
+                                         const Cell::Tag* tags,
+                                         size_t           n) {
+                                      for (size_t i = 0; i < n; ++i) {
+                                          check(tags[i].type);
+                                      }
+                                      add(numbers, n);
+                                  });
+            }
+        }
+
+        double result() const { // Итоговое значение операции
+            switch (op) {
+                case SUM:
+                case PRODUCT:
+                    return total;
+                case AVERAGE:
+                    if (count == 0) {
+                        throw std::runtime_error(
+                            "Не найдено числовых ячеек для операции "
+                            "среднего.");
+                    }
+                    return total / count;
+            }
+            throw std::logic_error("Неверный тип операции.");
+        }
+    };
+
+    double compute() const { // Метод для выполнения операции
+        Accumulator accumulator(operationType, precision);
+        if (!view.empty()) { // Столбцы диапазона сворачиваются целиком
+            accumulator.add(view);
+            return accumulator.result();
+        }
+        double block[256]; // Числа собираются блоками для ядер свёртки
+        size_t filled = 0;
+        for (const auto& cell : range) {
+            accumulator.check(cell.getType());
+            block[filled++] = cell.getNumber();
+            if (filled == sizeof(block) / sizeof(block[0])) {
+                accumulator.add(block, filled);
+                filled = 0;
+            }
+        }
+        accumulator.add(block, filled);
+        return accumulator.result();
+    }
+
+    Operation getOperation() const {
+        return operationType;
+    } // Метод, возвращающий операцию
+
+    void displayResult() const { // Метод, выводящий результат на экран
+        try {
+            std::cout << "Результат: " << compute() << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Ошибка: " << e.what() << std::endl;
+        }
+    }
+
+    void changeOperation(Operation oper) {
+        operationType = oper;
+    } // Метод изменения операции
+
+    Precision getPrecision() const {
+        return precision;
+    } // Метод, возвращающий режим суммирования
+
+    void changePrecision(Precision mode) {
+        precision = mode;
+    } // Метод изменения режима суммирования
+
+    std::string identify() const {
+        return "FormulaCell";
+    } // Метод идентификации
+};
+
+// Класс PrefixIndex - Индекс префиксных сумм (таблица сумм по
+// прямоугольникам): для каждой позиции хранит сумму чисел и кол-во числовых
+// ячеек в прямоугольнике от начала таблицы, поэтому SUM и AVERAGE любого
+// диапазона считаются за O(1). Суммы хранятся числами двойной длины вместе
+// с оценкой их погрешности: разность больших префиксов теряет знаки, и если
+// оценка погрешности ответа больше единицы его последнего знака, диапазон
+// считается напрямую. Для PRODUCT по желанию хранятся суммы логарифмов
+// модулей, кол-во нулей и отрицательных чисел; такое произведение
+// приближенное, и точность не проверяется.
+
+class PrefixIndex {
+private:
+    struct Wide {  // Число двойной длины: hi + lo, |lo| не больше половины
+                   // последнего знака hi
+        double hi; // Старшая часть
+        double lo; // Младшая часть
+
+        friend Wide operator+(Wide a, Wide b) { // Сумма с погрешностью не
+                                                // больше 4u^2 (|a| + |b|)
+            double sum  = a.hi + b.hi;
+            double part = sum - a.hi;
+            double tail =
+                (a.hi - (sum - part)) + (b.hi - part) + a.lo + b.lo;
+            Wide result;
+            result.hi = sum + tail;
+            result.lo = tail - (result.hi - sum);
+            return result;
+        }
+
+        friend Wide operator-(Wide a, Wide b) {
+            b.hi = -b.hi;
+            b.lo = -b.lo;
+            return a + b;
+        } // Разность с той же погрешностью
+    };
+
+    static constexpr double kUnit =
+        std::numeric_limits<double>::epsilon() / 2; // Единица округления u
+
+    size_t                height;    // Кол-во строк таблицы + 1
+    bool                  product;   // Построена ли часть для PRODUCT
+    std::vector<Wide>     sums;      // Суммы конечных чисел
+    std::vector<double>   slack;     // Оценки погрешности sums
+    std::vector<uint64_t> numbers;   // Кол-во числовых ячеек
+    std::vector<uint64_t> irregular; // Кол-во бесконечностей и NaN
+    std::vector<double>   logs;      // Суммы логарифмов модулей чисел
+    std::vector<uint64_t> zeros;     // Кол-во нулей
+    std::vector<uint64_t> negatives; // Кол-во отрицательных чисел
+
+    size_t at(size_t i, size_t j) const {
+        return j * height + i;
+    } // Позиция префикса первых i строк и j столбцов
+
+    template <class T>
+    void extend(std::vector<T>& prefix,
+                size_t          i,
+                size_t          j,
+                T               value) { // Префикс с ячейкой (i, j)
+        prefix[at(i + 1, j + 1)] = value + prefix[at(i, j + 1)] +
+                                   prefix[at(i + 1, j)] - prefix[at(i, j)];
+    }
+
+    template <class T>
+    T total(const std::vector<T>& prefix,
+            size_t                rowFrom,
+            size_t                colFrom,
+            size_t                rowTo,
+            size_t                colTo) const { // Значение по диапазону
+        return (prefix[at(rowTo + 1, colTo + 1)] -
+                prefix[at(rowFrom, colTo + 1)]) -
+               (prefix[at(rowTo + 1, colFrom)] -
+                prefix[at(rowFrom, colFrom)]);
+    }
+
+    void add(size_t i,
+             size_t j,
+             bool   isNumber,
+             double number) { // Учет ячейки (i, j) в префиксах
+        double value  = isNumber ? number : 0.0;
+        bool   finite = std::isfinite(value);
+        Wide   cell   = {finite ? value : 0.0, 0.0};
+        extend(sums, i, j, cell);
+        // Три сложения префикса ошибаются не больше чем на 12u^2 суммы
+        // модулей слагаемых; ошибка префикса - сумма ошибок его ячеек
+        extend(slack,
+               i,
+               j,
+               16 * kUnit * kUnit *
+                   (std::fabs(cell.hi) + std::fabs(sums[at(i, j + 1)].hi) +
+                    std::fabs(sums[at(i + 1, j)].hi) +
+                    std::fabs(sums[at(i, j)].hi)));
+        extend<uint64_t>(numbers, i, j, isNumber);
+        extend<uint64_t>(irregular, i, j, !finite);
+        if (product) {
+            bool zero = !isNumber || value == 0.0 || !finite;
+            extend(logs, i, j, zero ? 0.0 : std::log(std::fabs(value)));
+            extend<uint64_t>(zeros, i, j, isNumber && value == 0.0);
+            extend<uint64_t>(negatives, i, j, value < 0.0);
+        }
+    }
+
+    bool sum(size_t  rowFrom,
+             size_t  colFrom,
+             size_t  rowTo,
+             size_t  colTo,
+             double& result) const { // Сумма чисел диапазона; false, если
+                                     // погрешность может превысить единицу
+                                     // последнего знака ответа
+        size_t corners[4] = {at(rowTo + 1, colTo + 1),
+                             at(rowFrom, colTo + 1),
+                             at(rowTo + 1, colFrom),
+                             at(rowFrom, colFrom)};
+        Wide   range      = total(sums, rowFrom, colFrom, rowTo, colTo);
+        double error      = 0.0; // Ошибка префиксов и трех вычитаний
+        for (size_t corner : corners) {
+            error += 2 * slack[corner] +
+                     16 * kUnit * kUnit * std::fabs(sums[corner].hi);
+        }
+        if (error > kUnit * std::fabs(range.hi)) {
+            return false;
+        }
+        result = range.hi;
+        return true;
+    }
+
+public:
+    PrefixIndex(const std::vector<Column>& columns,
+                size_t                     rows,
+                bool withProduct) // Построение индекса по столбцам таблицы
+        : height(rows + 1), product(withProduct) {
+        size_t cells = (columns.size() + 1) * height;
+        sums.assign(cells, Wide());
+        slack.assign(cells, 0.0);
+        numbers.assign(cells, 0);
+        irregular.assign(cells, 0);
+        if (product) {
+            logs.assign(cells, 0.0);
+            zeros.assign(cells, 0);
+            negatives.assign(cells, 0);
+        }
+        for (size_t j = 0; j < columns.size(); ++j) {
+            size_t i = 0; // Номер текущей строки
+            columns[j].forEachSlice(
+                0,
+                rows,
+                [&](const double* values, const Cell::Tag* tags, size_t n) {
+                    for (size_t k = 0; k < n; ++k, ++i) {
+                        add(i, j, tags[k].type == Cell::NUMBER, values[k]);
+                    }
+                });
+        }
+    }
+
+    bool hasProduct() const {
+        return product;
+    } // Построена ли часть для PRODUCT
+
+
+    bool compute(size_t                 rowFrom,
+                 size_t                 colFrom,
+                 size_t                 rowTo,
+                 size_t                 colTo,
+                 FormulaCell::Operation op,
+                 double& result) const { // Вычисление операции по индексу;
+                                         // false - считать напрямую
+        if (rowFrom > rowTo || colFrom > colTo) {
+            return false;
+        }
+        uint64_t area = static_cast<uint64_t>(rowTo - rowFrom + 1) *
+                        (colTo - colFrom + 1);
+        if (total(numbers, rowFrom, colFrom, rowTo, colTo) != area) {
+            // В диапазоне есть нечисловая ячейка
+            FormulaCell::Accumulator(op).check(Cell::EMPTY);
+        }
+        if (total(irregular, rowFrom, colFrom, rowTo, colTo) != 0) {
+            return false;
+        }
+        switch (op) {
+            case FormulaCell::SUM:
+            case FormulaCell::AVERAGE:
+                if (!sum(rowFrom, colFrom, rowTo, colTo, result)) {
+                    return false;
+                }
+                if (op == FormulaCell::AVERAGE) {
+                    result /= static_cast<double>(area);
+                }
+                return true;
+            case FormulaCell::PRODUCT:
+                if (!product) {
+                    return false;
+                }
+                if (total(zeros, rowFrom, colFrom, rowTo, colTo) != 0) {
+                    result = 0.0;
+                    return true;
+                }
+                result = std::exp(total(logs, rowFrom, colFrom, rowTo, colTo));
+                if (total(negatives, rowFrom, colFrom, rowTo, colTo) % 2 != 0) {
+                    result = -result;
+                }
+                return true;
+        }
+        return false;
+    }
+};
+
+// Класс TaskPool - Пул потоков с перехватом задач: у каждого потока своя
+// очередь, задача, порожденная потоком, кладется в его очередь, а
+// освободившийся поток забирает задачи из начала чужих очередей. Пул
+// работает, пока не выполнены все поставленные задачи.
+
+class TaskPool {
+public:
+    typedef std::function<void(size_t)> Task; // Задача с номером потока
+
+private:
+    struct Queue {               // Очередь задач потока
+        std::mutex       lock;  // Защита очереди
+        std::deque<Task> tasks; // Задачи потока
+    };
+
+    std::vector<std::unique_ptr<Queue> > queues;  // Очереди потоков
+    std::atomic<size_t>                  pending; // Невыполненные задачи
+    std::mutex                           errorLock; // Защита error
+    std::exception_ptr                   error; // Первое исключение задачи
+
+    bool take(size_t worker, Task& task) { // Своя задача или чужая
+        {
+            Queue&                      own = *queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); ++k) {
+            Queue& victim = *queues[(worker + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(size_t worker) { // Цикл потока
+        Task task;
+        while (pending.load() > 0) {
+            if (!take(worker, task)) {
+                std::this_thread::yield();
+                continue;
+            }
+            try {
+                task(worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            pending.fetch_sub(1);
+        }
+    }
+
+public:
+    explicit TaskPool(size_t threads) : queues(threads), pending(0) {
+        for (std::unique_ptr<Queue>& queue : queues) {
+            queue = std::make_unique<Queue>();
+        }
+    }
+
+    size_t size() const { return queues.size(); } // Кол-во потоков
+
+    void submit(size_t worker, Task task) { // Постановка задачи в очередь
+        pending.fetch_add(1);
+        std::lock_guard<std::mutex> guard(queues[worker]->lock);
+        queues[worker]->tasks.push_back(std::move(task));
+    }
+
+    void run() { // Выполнение всех задач, включая порожденные
+        Parallel::run(queues.size(), [this](size_t worker) { work(worker); });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+// Структура CsvOptions - Параметры чтения CSV-файла.
+
+struct CsvOptions {
+    char   delimiter; // Разделитель полей
+    char   quote;     // Символ кавычки (RFC 4180)
+    size_t threads;   // Кол-во потоков разбора (0 - по числу ядер)
+    bool   lazy;      // Ленивый разбор: при чтении запоминаются только
+                      // границы полей, а столбец разбирается при первом
+                      // обращении к нему
+
+    CsvOptions(char   delim       = ',',
+               char   quoteChar   = '"',
+               size_t threadCount = 0,
+               bool   lazyParse   = false)
+        : delimiter(delim),
+          quote(quoteChar),
+          threads(threadCount),
+          lazy(lazyParse) {}
+};
+
+// Структура ReadStats - Итоги чтения файла: объем и скорость.
+
+struct ReadStats {
+    size_t bytes;      // Прочитано байт
+    size_t rows;       // Прочитано строк таблицы
+    size_t textFields; // Поля, не распознанные как числа (при ленивом
+                       // разборе поля разбираются позже и здесь не
+                       // учитываются)
+    size_t paddedRows; // Строки короче самой длинной, дополненные пустыми
+                       // ячейками
+    size_t threads;    // Кол-во потоков разбора
+    double seconds;    // Затраченное время
+
+    double megabytesPerSecond() const { // Скорость чтения, МБ/с
+        return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0;
+    }
+};
+
+// Класс CsvParser - Разбор CSV по RFC 4180 прямо по столбцам таблицы.
+// Границы полей и строк ищутся через memchr, числа распознаются через
+// std::from_chars без исключений. Пустые строки файла записями не
+// считаются, а байты между закрывающей кавычкой и разделителем остаются в
+// поле. Большой файл делится на части по байтам, которые разбираются
+// параллельно, а получившиеся блоки столбцов сцепляются без копирования.
+// Границы частей ищутся по тем же правилам кавычек, что и поля, поэтому
+// параллельный разбор дает те же строки, что и разбор в один поток.
+
+class CsvParser {
+public:
+    enum Quoting : uint8_t { // Состояние разбора в точке текста: кавычка
+                             // открывает поле, только если стоит в его
+                             // начале
+        FIELD_START,         // Начало поля
+        UNQUOTED,            // Поле без кавычек; кавычка в нем - обычный
+                             // символ
+        QUOTED,              // Поле в кавычках
+        CLOSED               // Кавычка в поле в кавычках: закрывающая или
+                             // первая из удвоенных
+    };
+
+    template <class OnRecord>
+    static Quoting walk(const char*&      pos,
+                        const char*       end,
+                        Quoting           state,
+                        const CsvOptions& options,
+                        OnRecord onRecord) { // Проход текста от pos по тем
+                                             // же правилам, что и у scan.
+                                             // onRecord(p) вызывается в
+                                             // конце каждой записи (p -
+                                             // начало следующей); false из
+                                             // него останавливает проход
+        while (pos < end) {
+            if (state == QUOTED) { // Ищем закрывающую кавычку
+                const void* found = std::memchr(pos, options.quote, end - pos);
+                if (!found) {
+                    pos = end;
+                    break;
+                }
+                pos   = static_cast<const char*>(found) + 1;
+                state = CLOSED;
+                continue;
+            }
+            char c = *pos++;
+            if (c == options.quote) { // Открывающая или удвоенная кавычка
+                state = state == UNQUOTED ? UNQUOTED : QUOTED;
+            } else if (c == '\n') {
+                state = FIELD_START;
+                if (!onRecord(pos)) {
+                    break;
+                }
+            } else {
+                state = c == options.delimiter ? FIELD_START : UNQUOTED;
+            }
+        }
+        return state;
+    }
+
+    static bool parseNumber(std::string_view field,
+                            double& number) { // Число из непустого поля;
+                                              // false, если поле - текст
+        const char* first = field.data();
+        const char* last  = first + field.size();
+        if (*first == '+' && field.size() > 1 && first[1] != '-') {
+            ++first; // from_chars не принимает явный плюс
+        }
+        std::from_chars_result parsed = std::from_chars(first, last, number);
+        return parsed.ec == std::errc() && parsed.ptr == last;
+    }
+
+    static Cell parseField(
+        std::string_view   field,
+        StringPool::Cache* cache = nullptr) { // Ячейка по значению поля
+        if (field.empty()) {
+            return Cell();
+        }
+        double number;
+        if (parseNumber(field, number)) {
+            return Cell(number);
+        }
+        Cell text;
+        text.setText(field, cache);
+        return text;
+    }
+
+    static size_t parse(const char*          data,
+                        size_t               size,
+                        const CsvOptions&    options,
+                        std::vector<Column>& columns) { // Разбор текста;
+                                                        // возвращает кол-во
+                                                        // строк
+        CellSink sink(columns);
+        return scan(data, size, options, sink).rows;
+    }
+
+    static size_t parseParallel(
+        const char*          data,
+        size_t               size,
+        const CsvOptions&    options,
+        std::vector<Column>& columns,
+        ReadStats& stats) { // Параллельный разбор; заполняет в stats кол-во
+                            // строк, текстовых полей, дополненных строк и
+                            // потоков и возвращает кол-во строк
+        size_t threads = threadCount(options, size);
+        if (threads == 1) {
+            CellSink sink(columns);
+            Shape    shape = scan(data, size, options, sink);
+            return finish(stats, &shape, 1, shape.width, sink.words);
+        }
+        std::vector<size_t> bounds = split(data, size, threads, options);
+        std::vector<std::vector<Column> > fragments(threads);
+        std::vector<Shape>                shapes(threads);
+        std::vector<size_t>               words(threads);
+        Parallel::run(threads, [&](size_t k) {
+            CellSink sink(fragments[k]);
+            shapes[k] = scan(data + bounds[k],
+                             bounds[k + 1] - bounds[k],
+                             options,
+                             sink);
+            words[k]  = sink.words;
+        });
+
+        size_t width = 0, text = 0; // Ширина - по самой длинной строке
+        for (size_t k = 0; k < threads; ++k) {
+            width = std::max(width, shapes[k].width);
+            text += words[k];
+        }
+        columns.assign(width, Column());
+        for (size_t k = 0; k < threads; ++k) {
+            for (size_t j = 0; j < width; ++j) {
+                if (j < fragments[k].size()) {
+                    columns[j].append(std::move(fragments[k][j]));
+                } else {
+                    columns[j].pushEmpty(shapes[k].rows);
+                }
+            }
+        }
+        return finish(stats, shapes.data(), threads, width, text);
+    }
+
+    static size_t parseLazy(
+        std::shared_ptr<const MappedFile> file,
+        const CsvOptions&                 options,
+        std::vector<Column>&              columns,
+        ReadStats& stats) { // Ленивый разбор: столбцы из неразобранных
+                            // полей файла; заполняет stats так же, как
+                            // parseParallel, и возвращает кол-во строк
+        const char* data    = file->data();
+        size_t      size    = file->size();
+        size_t      threads = threadCount(options, size);
+        std::vector<size_t> bounds(2, 0);
+        bounds[1] = size;
+        if (threads > 1) {
+            bounds = split(data, size, threads, options);
+        }
+        std::vector<RawSink> fragments(threads, RawSink(data));
+        std::vector<Shape>   shapes(threads);
+        Parallel::run(threads, [&](size_t k) {
+            shapes[k] = scan(data + bounds[k],
+                             bounds[k + 1] - bounds[k],
+                             options,
+                             fragments[k]);
+        });
+
+        size_t width = 0; // Ширина - по самой длинной строке
+        for (size_t k = 0; k < threads; ++k) {
+            width = std::max(width, shapes[k].width);
+        }
+        size_t rows = finish(stats, shapes.data(), threads, width, 0);
+        columns.assign(width, Column());
+        for (size_t j = 0; j < width; ++j) {
+            std::shared_ptr<Column::Chunk::Raw> raw =
+                std::make_shared<Column::Chunk::Raw>(file, parseField);
+            raw->fields.reserve(rows);
+            for (size_t k = 0; k < threads; ++k) {
+                if (j >= fragments[k].width()) { // Строки части короче
+                    raw->fields.resize(raw->fields.size() + shapes[k].rows,
+                                       Column::Chunk::RawField());
+                    continue;
+                }
+                std::vector<Column::Chunk::RawField>& fields =
+                    fragments[k].fields[j];
+                for (Column::Chunk::RawField& field : fields) {
+                    if (field.unquoted) { // Сдвиг на тексты прежних частей
+                        field.offset += raw->text.size();
+                    }
+                }
+                raw->fields.insert(
+                    raw->fields.end(), fields.begin(), fields.end());
+                raw->text += fragments[k].texts[j];
+                std::vector<Column::Chunk::RawField>().swap(fields);
+                std::string().swap(fragments[k].texts[j]);
+            }
+            for (size_t k = 0; k * Column::kChunkRows < rows; ++k) {
+                columns[j].pushChunk(Column::Chunk(raw, k));
+            }
+        }
+        return rows;
+    }
+
+private:
+    friend class CsvStream;
+
+    struct Shape { // Итог разбора части текста
+        size_t rows  = 0; // Кол-во строк
+        size_t width = 0; // Наибольшее кол-во полей в строке
+        size_t full  = 0; // Кол-во строк с width полями
+
+        size_t padded(size_t columns) const { // Кол-во строк, дополненных
+                                              // пустыми ячейками до columns
+                                              // столбцов
+            return width == columns ? rows - full : rows;
+        }
+    };
+
+    static size_t finish(ReadStats&   stats,
+                         const Shape* shapes,
+                         size_t       parts,
+                         size_t       width,
+                         size_t words) { // Итоги разбора частей в stats;
+                                         // возвращает кол-во строк
+        stats.rows       = 0;
+        stats.paddedRows = 0;
+        for (size_t k = 0; k < parts; ++k) {
+            stats.rows += shapes[k].rows;
+            stats.paddedRows += shapes[k].padded(width);
+        }
+        stats.textFields = words;
+        stats.threads    = parts;
+        return stats.rows;
+    }
+
+    struct CellSink { // Приемник полей: ячейки сразу дописываются в столбцы
+        std::vector<Column>& columns; // Столбцы таблицы
+        StringPool::Cache    texts;   // Недавние длинные строки этого потока
+        size_t               words;   // Поля, прочитанные как текст
+
+        explicit CellSink(std::vector<Column>& target)
+            : columns(target), words(0) {}
+
+        size_t width() const { return columns.size(); } // Кол-во столбцов
+        void   addColumn(size_t rows) {
+            columns.push_back(Column(rows));
+        } // Новый столбец, пустой в предыдущих rows строках
+        void field(size_t j, std::string_view value, bool) {
+            Cell cell = parseField(value, &texts);
+            words += cell.getType() == Cell::TEXT;
+            columns[j].push(std::move(cell));
+        } // Очередное поле j-го столбца
+        void skip(size_t j) {
+            columns[j].push(Cell());
+        } // Недостающее поле j-го столбца
+    };
+
+    struct RawSink { // Приемник полей ленивого разбора: запоминаются только
+                     // границы полей в файле
+        const char* base; // Начало файла
+        std::vector<std::vector<Column::Chunk::RawField> >
+                                 fields; // Поля каждого столбца
+        std::vector<std::string> texts;  // Поля в кавычках с удвоенными
+                                         // кавычками каждого столбца
+
+        explicit RawSink(const char* data) : base(data) {}
+
+        size_t width() const { return fields.size(); } // Кол-во столбцов
+        void   addColumn(size_t rows) {
+            fields.push_back(std::vector<Column::Chunk::RawField>(
+                rows, Column::Chunk::RawField()));
+            texts.push_back(std::string());
+        } // Новый столбец, пустой в предыдущих rows строках
+        void field(size_t j, std::string_view value, bool copied) {
+            Column::Chunk::RawField field;
+            field.length   = static_cast<uint32_t>(value.size());
+            field.unquoted = copied;
+            if (copied) {
+                field.offset = texts[j].size();
+                texts[j].append(value.data(), value.size());
+            } else {
+                field.offset = value.data() - base;
+            }
+            fields[j].push_back(field);
+        } // Очередное поле j-го столбца
+        void skip(size_t j) {
+            fields[j].push_back(Column::Chunk::RawField());
+        } // Недостающее поле j-го столбца
+    };
+
+    template <class Sink>
+    static Shape scan(const char*       data,
+                      size_t            size,
+                      const CsvOptions& options,
+                      Sink& sink) { // Поиск полей текста; каждое поле
+                                    // передается в sink вместе с признаком
+                                    // того, что оно скопировано из файла
+                                    // без удвоенных кавычек. Возвращает
+                                    // кол-во строк и их ширину
+        const char* pos = data;
+        const char* end = data + size;
+        Shape       shape;
+        std::string unescaped; // Поле в кавычках без удвоенных кавычек
+        while (pos < end) {
+            const char* lineEnd = findLineEnd(pos, end);
+            if (lineEnd == pos || (lineEnd == pos + 1 && *pos == '\r')) {
+                pos = lineEnd + 1; // Пустая строка - не запись
+                continue;
+            }
+            size_t j = 0; // Номер текущего столбца
+            for (;;) {
+                std::string_view field;
+                bool             copied = false;
+                if (pos < end && *pos == options.quote) {
+                    const char* opening = pos + 1;
+                    pos = parseQuoted(opening, end, options.quote, unescaped);
+                    copied  = unescaped.size() + 1 !=
+                             static_cast<size_t>(pos - opening);
+                    field   = copied ? std::string_view(unescaped)
+                                     : std::string_view(opening,
+                                                        unescaped.size());
+                    lineEnd = findLineEnd(pos, end); // Поле могло занять
+                                                     // несколько строк
+                    const char* stop =
+                        findDelimiter(pos, lineEnd, options.delimiter);
+                    const char* tailEnd = trimLineEnd(pos, stop, lineEnd);
+                    if (tailEnd > pos) { // Байты после закрывающей кавычки
+                                         // дописываются к полю, как у
+                                         // нестрогих разборщиков RFC 4180
+                        unescaped.append(pos, tailEnd);
+                        copied = true;
+                        field  = std::string_view(unescaped);
+                    }
+                    pos = stop;
+                } else {
+                    const char* stop =
+                        findDelimiter(pos, lineEnd, options.delimiter);
+                    field = std::string_view(
+                        pos, trimLineEnd(pos, stop, lineEnd) - pos);
+                    pos = stop;
+                }
+                if (j == sink.width()) {
+                    sink.addColumn(shape.rows); // Новый столбец пуст в
+                                                // предыдущих строках
+                }
+                sink.field(j, field, copied);
+                if (pos < lineEnd && *pos == options.delimiter) {
+                    ++pos;
+                    ++j;
+                    continue;
+                }
+                break;
+            }
+            size_t fields = ++j; // Кол-во полей строки
+            for (; j < sink.width(); j++) {
+                sink.skip(j); // Недостающие значения - пустые
+            }
+            if (fields > shape.width) {
+                shape.width = fields;
+                shape.full  = 0;
+            }
+            shape.full += fields == shape.width;
+            pos = lineEnd < end ? lineEnd + 1 : end;
+            shape.rows++;
+        }
+        return shape;
+    }
+
+    static size_t threadCount(const CsvOptions& options,
+                              size_t size) { // Кол-во потоков разбора
+        size_t threads = options.threads;
+        if (threads == 0) { // Не меньше мегабайта на поток
+            threads = std::min(Parallel::hardwareThreads(),
+                               size / (1 << 20) + 1);
+        }
+        return std::max<size_t>(1, std::min(threads, size));
+    }
+
+    static std::vector<size_t> split(
+        const char*       data,
+        size_t            size,
+        size_t            parts,
+        const CsvOptions& options) { // Границы частей файла по началам
+                                     // записей
+        std::vector<size_t> cuts(parts + 1), bounds(parts + 1);
+        for (size_t k = 0; k <= parts; ++k) {
+            cuts[k] = size / parts * k;
+        }
+        cuts[parts] = size;
+        // Состояние в начале части заранее неизвестно, поэтому для каждой
+        // части находится состояние в ее конце при любом состоянии в
+        // начале. После первого символа различных состояний обычно
+        // остается два: в кавычках и вне их
+        std::vector<std::vector<Quoting> > ends(parts,
+                                               std::vector<Quoting>(4));
+        auto any = [](const char*) { return true; };
+        Parallel::run(parts, [&](size_t k) {
+            const char* end = data + cuts[k + 1];
+            Quoting     done[4];
+            bool        known[4] = {};
+            for (int s = 0; s < 4; ++s) {
+                const char* pos   = data + cuts[k];
+                Quoting     state = walk(
+                    pos, std::min(pos + 1, end), Quoting(s), options, any);
+                if (!known[state]) {
+                    done[state]  = walk(pos, end, state, options, any);
+                    known[state] = true;
+                }
+                ends[k][s] = done[state];
+            }
+        });
+        // Часть начинается после первого конца записи за разрезом
+        Quoting state = FIELD_START; // Состояние на разрезе
+        bounds[0]     = 0;
+        bounds[parts] = size;
+        for (size_t k = 1; k < parts; ++k) {
+            state           = ends[k - 1][state];
+            const char* pos = data + cuts[k];
+            walk(pos, data + size, state, options, [](const char*) {
+                return false;
+            });
+            bounds[k] = std::max<size_t>(pos - data, bounds[k - 1]);
+        }
+        return bounds;
+    }
+
+    static const char* findLineEnd(const char* pos, const char* end) {
+        const void* found = std::memchr(pos, '\n', end - pos);
+        return found ? static_cast<const char*>(found) : end;
+    } // Конец текущей строки файла
+
+    static const char* trimLineEnd(const char* pos,
+                                   const char* stop,
+                                   const char* lineEnd) {
+        return stop == lineEnd && stop > pos && stop[-1] == '\r' ? stop - 1
+                                                                  : stop;
+    } // Конец поля [pos, stop) без '\r' перед переводом строки
+
+    static const char* findDelimiter(const char* pos,
+                                     const char* lineEnd,
+                                     char        delimiter) {
+        const void* found = std::memchr(pos, delimiter, lineEnd - pos);
+        return found ? static_cast<const char*>(found) : lineEnd;
+    } // Ближайший разделитель в пределах строки
+
+    static const char* parseQuoted(
+        const char*  pos,
+        const char*  end,
+        char         quote,
+        std::string& unescaped) { // Поле в кавычках; возвращает позицию
+                                  // после закрывающей кавычки
+        unescaped.clear();
+        for (;;) {
+            const void* found = std::memchr(pos, quote, end - pos);
+            if (!found) {
+                throw std::runtime_error("Незакрытая кавычка в CSV-файле.");
+            }
+            const char* closing = static_cast<const char*>(found);
+            unescaped.append(pos, closing);
+            if (closing + 1 < end && closing[1] == quote) {
+                unescaped.push_back(quote); // Удвоенная кавычка внутри поля
+                pos = closing + 2;
+                continue;
+            }
+            return closing + 1;
+        }
+    }
+};
+
+// Структура ColumnSummary - Сводка по числовым ячейкам столбца. Если чисел
+// в столбце нет, min, max и sum равны нулю.
+
+struct ColumnSummary {
+    size_t numbers; // Кол-во числовых ячеек
+    double min;     // Наименьшее число
+    double max;     // Наибольшее число
+    double sum;     // Сумма чисел
+
+    ColumnSummary() : numbers(0), min(0.0), max(0.0), sum(0.0) {}
+};
+
+// Класс FormulaGraph - Формулы, хранящиеся в ячейках таблицы. Формула
+// ссылается на диапазон по координатам, а зависимости между формулами
+// определяются тем, попадает ли ячейка одной формулы в диапазон другой.
+// Для поиска читателей ячейки формулы разложены по столбцам своих
+// диапазонов, поэтому изменение ячейки затрагивает только те формулы,
+// которые от нее зависят (в том числе через другие формулы). Копия графа
+// делит формулы с оригиналом, пока одна из них не изменит их.
+
+class FormulaGraph {
+public:
+    typedef std::pair<size_t, size_t> Key; // Строка и столбец формулы
+
+    struct Formula {                      // Описание формулы
+        size_t                 rowFrom;   // Первая строка диапазона
+        size_t                 colFrom;   // Первый столбец диапазона
+        size_t                 rowTo;     // Последняя строка диапазона
+        size_t                 colTo;     // Последний столбец диапазона
+        FormulaCell::Operation op;        // Операция
+        FormulaCell::Precision precision; // Режим суммирования
+    };
+
+private:
+    struct Reader {     // Формула, читающая часть столбца
+        size_t rowFrom; // Первая строка диапазона
+        size_t rowTo;   // Последняя строка диапазона
+        Key    cell;    // Ячейка формулы
+    };
+
+    struct Graph {                                  // Формулы таблицы
+        std::map<Key, Formula>            formulas; // Формулы по ячейкам
+        std::vector<std::vector<Reader> > readers;  // Читатели каждого
+                                                    // столбца
+    };
+
+    std::shared_ptr<Graph> graph; // Формулы (пусто - формул нет); общие для
+                                  // копий, пока одна из них не изменит их
+
+    const Graph& data() const { // Формулы для чтения
+        static const Graph none;
+        return graph ? *graph : none;
+    }
+
+    Graph& own() { // Формулы для изменения: общие формулы копируются
+        if (!graph) {
+            graph = std::make_shared<Graph>();
+        } else if (graph.use_count() > 1) {
+            graph = std::make_shared<Graph>(*graph);
+        }
+        return *graph;
+    }
+
+    template <class Visitor>
+    void forEachReader(Key cell, Visitor visit) const { // Обход формул,
+                                                        // читающих ячейку
+        const std::vector<std::vector<Reader> >& readers = data().readers;
+        if (cell.second >= readers.size()) {
+            return;
+        }
+        for (const Reader& reader : readers[cell.second]) {
+            if (reader.rowFrom <= cell.first && cell.first <= reader.rowTo) {
+                visit(reader.cell);
+            }
+        }
+    }
+
+    bool reaches(Key from, Key to) const { // Зависит ли to от from
+        std::vector<Key> stack(1, from);
+        std::set<Key>    visited;
+        bool             found = false;
+        while (!stack.empty() && !found) {
+            Key cell = stack.back();
+            stack.pop_back();
+            forEachReader(cell, [&](Key reader) {
+                if (reader == to) {
+                    found = true;
+                } else if (visited.insert(reader).second) {
+                    stack.push_back(reader);
+                }
+            });
+        }
+        return found;
+    }
+
+    void link(Key cell, const Formula& formula) { // Добавление без проверок
+        Graph&                             mine    = own();
+        std::vector<std::vector<Reader> >& readers = mine.readers;
+        mine.formulas[cell]                        = formula;
+        if (formula.rowFrom > formula.rowTo ||
+            formula.colFrom > formula.colTo) {
+            return;
+        }
+        if (readers.size() <= formula.colTo) {
+            readers.resize(formula.colTo + 1);
+        }
+        for (size_t j = formula.colFrom; j <= formula.colTo; ++j) {
+            readers[j].push_back(Reader{formula.rowFrom, formula.rowTo, cell});
+        }
+    }
+
+public:
+    bool   empty() const { return data().formulas.empty(); } // Нет ли формул
+    size_t size() const { return data().formulas.size(); }   // Кол-во формул
+
+    const Formula* find(size_t row,
+                        size_t col) const { // Формула ячейки или nullptr
+        const std::map<Key, Formula>&          formulas = data().formulas;
+        std::map<Key, Formula>::const_iterator it =
+            formulas.find(Key(row, col));
+        return it == formulas.end() ? nullptr : &it->second;
+    }
+
+    void add(size_t row,
+             size_t col,
+             const Formula& formula) { // Добавление или замена формулы
+        Key            cell(row, col);
+        const Formula* previous = find(row, col);
+        Formula        replaced = previous ? *previous : formula;
+        bool           existed  = previous != nullptr;
+        remove(row, col);
+        link(cell, formula);
+        if (reaches(cell, cell)) {
+            remove(row, col);
+            if (existed) {
+                link(cell, replaced);
+            }
+            throw std::invalid_argument(
+                "Формула образует циклическую зависимость.");
+        }
+    }
+
+    bool remove(size_t row, size_t col) { // Удаление формулы ячейки
+        if (!find(row, col)) {
+            return false; // Общие формулы не копируются без изменений
+        }
+        Graph&                             mine     = own();
+        std::map<Key, Formula>&            formulas = mine.formulas;
+        std::vector<std::vector<Reader> >& readers  = mine.readers;
+        std::map<Key, Formula>::iterator   it = formulas.find(Key(row, col));
+        const Formula&                     formula = it->second;
+        if (formula.rowFrom <= formula.rowTo &&
+            formula.colFrom <= formula.colTo) {
+            for (size_t j = formula.colFrom; j <= formula.colTo; ++j) {
+                std::vector<Reader>& list = readers[j];
+                list.erase(std::find_if(list.begin(),
+                                        list.end(),
+                                        [&](const Reader& reader) {
+                                            return reader.cell == it->first;
+                                        }));
+            }
+        }
+        formulas.erase(it);
+        return true;
+    }
+
+    std::vector<Key> order(const std::vector<Key>& seeds)
+        const { // Формулы seeds и все зависящие от них в порядке расчета
+        struct Frame {              // Формула в стеке обхода
+            Key              cell;  // Ячейка формулы
+            std::vector<Key> next;  // Формулы, читающие ее ячейку
+            size_t           index; // Кол-во пройденных читателей
+        };
+        std::vector<Key>   result;
+        std::set<Key>      visited;
+        std::vector<Frame> stack;
+        for (const Key& seed : seeds) {
+            if (!visited.insert(seed).second) {
+                continue;
+            }
+            stack.push_back(Frame{seed, std::vector<Key>(), 0});
+            forEachReader(seed, [&](Key reader) {
+                stack.back().next.push_back(reader);
+            });
+            while (!stack.empty()) {
+                Frame& top = stack.back();
+                if (top.index == top.next.size()) {
+                    result.push_back(top.cell); // Все читатели уже учтены
+                    stack.pop_back();
+                    continue;
+                }
+                Key reader = top.next[top.index++];
+                if (visited.insert(reader).second) {
+                    stack.push_back(Frame{reader, std::vector<Key>(), 0});
+                    forEachReader(reader, [&](Key next) {
+                        stack.back().next.push_back(next);
+                    });
+                }
+            }
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    std::vector<Key> readersOf(
+        Key cell) const { // Формулы, в диапазон которых попадает ячейка
+        std::vector<Key> result;
+        forEachReader(cell, [&](Key reader) { result.push_back(reader); });
+        return result;
+    }
+
+    std::vector<Key> affected(size_t row, size_t col)
+        const { // Формулы, которые нужно пересчитать после изменения ячейки
+        std::vector<Key> seeds;
+        forEachReader(Key(row, col),
+                      [&](Key reader) { seeds.push_back(reader); });
+        return order(seeds);
+    }
+
+    std::vector<Key> all() const { // Все формулы в порядке расчета
+        std::vector<Key> seeds;
+        seeds.reserve(size());
+        for (const auto& item : data().formulas) {
+            seeds.push_back(item.first);
+        }
+        return order(seeds);
+    }
+
+    void retain(size_t rows,
+                size_t cols) { // Удаление формул, не умещающихся в таблице
+        std::vector<Key> outside;
+        for (const auto& item : data().formulas) {
+            const Formula& formula = item.second;
+            if (item.first.first >= rows || item.first.second >= cols ||
+                (formula.rowFrom <= formula.rowTo &&
+                 formula.colFrom <= formula.colTo &&
+                 (formula.rowTo >= rows || formula.colTo >= cols))) {
+                outside.push_back(item.first);
+            }
+        }
+        for (const Key& cell : outside) {
+            remove(cell.first, cell.second);
+        }
+    }
+
+    void merge(const FormulaGraph& other,
+               size_t              rowOffset,
+               size_t colOffset) { // Добавление формул таблицы, чьи ячейки
+                                   // присоединены начиная со строки
+                                   // rowOffset и столбца colOffset
+        std::shared_ptr<Graph> source = other.graph; // Держит формулы other,
+                                                     // даже если это сам
+                                                     // граф
+        if (!source) {
+            return;
+        }
+        for (const auto& item : source->formulas) {
+            Formula formula = item.second;
+            formula.rowFrom += rowOffset;
+            formula.rowTo += rowOffset;
+            formula.colFrom += colOffset;
+            formula.colTo += colOffset;
+            link(Key(item.first.first + rowOffset,
+                     item.first.second + colOffset),
+                 formula);
+        }
+    }
+};
+
+// Класс TableFile - Собственный двоичный формат таблицы. После заголовка и
+// описаний столбцов идут выровненные по 64 байтам половины столбцов: числа
+// и служебные части ячеек (тип, длина и окончание короткого текста), затем
+// отпечатки блоков столбца, а в конце - словарь длинных строк. Ячейки
+// хранятся в том же виде, что и в памяти, поэтому при открытии файл
+// отображается в память, а блоки столбцов ссылаются прямо на него без
+// разбора и копирования.
+
+class TableFile {
+private:
+    static const uint32_t kVersion   = 2;          // Версия формата
+    static const uint32_t kByteOrder = 0x01020304; // Проверка порядка байтов
+    static const size_t   kAlignment = 64;         // Выравнивание данных
+
+    struct Header {                // Заголовок файла
+        char     magic[8];         // Сигнатура "TABLECOL"
+        uint32_t version;          // Версия формата
+        uint32_t byteOrder;        // kByteOrder в порядке байтов записи
+        uint64_t rows;             // Кол-во строк
+        uint64_t columns;          // Кол-во столбцов
+        uint64_t dictionaryOffset; // Смещение словаря строк
+        uint64_t dictionaryCount;  // Кол-во строк словаря
+        uint64_t reserved[2];      // Запас для следующих версий
+    };
+
+    struct Entry {              // Описание столбца
+        uint64_t numbersOffset; // Смещение чисел столбца
+        uint64_t tagsOffset;    // Смещение служебных частей ячеек
+        uint64_t printsOffset;  // Смещение отпечатков блоков
+        uint64_t numbers;       // Кол-во числовых ячеек
+        double   min;           // Наименьшее число
+        double   max;           // Наибольшее число
+        double   sum;           // Сумма чисел
+    };
+
+    static_assert(sizeof(Header) == 64, "Заголовок должен занимать 64 байта");
+    static_assert(sizeof(Entry) == 56, "Описание должно занимать 56 байт");
+
+    static uint64_t align(uint64_t offset) { // Выравнивание смещения
+        return (offset + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    static void pad(std::ofstream& out,
+                    uint64_t&      written,
+                    uint64_t       offset) { // Дозапись нулей до смещения
+        static const char zeros[kAlignment] = {};
+        out.write(zeros, static_cast<std::streamsize>(offset - written));
+        written = offset;
+    }
+
+    static void fail(const std::string& filename) { // Ошибка формата
+        throw std::runtime_error("Неверный формат файла таблицы: " + filename);
+    }
+
+    static Cell cellAt(const Column&    column,
+                       size_t           position,
+                       double           number,
+                       const Cell::Tag& tag) { // Ячейка участка столбца; в
+                                               // блоках из файла номер
+                                               // длинной строки - номер в
+                                               // словаре файла, поэтому такая
+                                               // ячейка берется через get
+        if (Cell::pooled(tag)) {
+            return column.get(position);
+        }
+        return Cell(number, tag);
+    }
+
+public:
+    static ColumnSummary summarize(const Column& column,
+                                   size_t rows) { // Сводка по столбцу
+        ColumnSummary             summary;
+        FormulaCell::Accumulator sum(FormulaCell::SUM);
+        column.forEachSlice(
+            0,
+            rows,
+            [&](const double* numbers, const Cell::Tag* tags, size_t n) {
+                if (tags == Column::emptyTags()) { // Пропуск пустых ячеек
+                    return;
+                }
+                size_t counted = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    if (tags[i].type != Cell::NUMBER) {
+                        continue;
+                    }
+                    double value = numbers[i];
+                    if (summary.numbers + counted == 0) {
+                        summary.min = summary.max = value;
+                    }
+                    summary.min = std::min(summary.min, value);
+                    summary.max = std::max(summary.max, value);
+                    ++counted;
+                }
+                if (counted == n) { // Числовой участок сворачивается так
+                    sum.add(numbers, n); // же, как в FormulaCell
+                } else {
+                    for (size_t i = 0; i < n; ++i) {
+                        if (tags[i].type == Cell::NUMBER) {
+                            sum.add(numbers[i]);
+                        }
+                    }
+                }
+                summary.numbers += counted;
+            });
+        summary.sum = sum.result();
+        return summary;
+    }
+
+    static void save(const std::string&         filename,
+                     const std::vector<Column>& columns,
+                     size_t rows) { // Запись столбцов в файл
+        Header header = {};
+        std::memcpy(header.magic, "TABLECOL", sizeof(header.magic));
+        header.version   = kVersion;
+        header.byteOrder = kByteOrder;
+        header.rows      = rows;
+        header.columns   = columns.size();
+
+        // Первый проход: сводки, смещения, отпечатки блоков по kChunkRows
+        // строк и номера длинных строк в словаре
+        size_t blocks = (rows + Column::kChunkRows - 1) / Column::kChunkRows;
+        std::vector<std::vector<uint64_t> > prints(
+            columns.size(), std::vector<uint64_t>(blocks, 0));
+        std::vector<Entry> entries(columns.size());
+        std::unordered_map<const StringPool::Entry*, uint64_t> fileIds;
+        std::vector<const StringPool::Entry*> texts; // Строки словаря; живы,
+                                                     // пока жива таблица
+        uint64_t offset =
+            align(sizeof(Header) + sizeof(Entry) * columns.size());
+        for (size_t j = 0; j < columns.size(); ++j) {
+            ColumnSummary summary    = summarize(columns[j], rows);
+            entries[j].numbers       = summary.numbers;
+            entries[j].min           = summary.min;
+            entries[j].max           = summary.max;
+            entries[j].sum           = summary.sum;
+            entries[j].numbersOffset = offset;
+            offset                   = align(offset + rows * sizeof(double));
+            entries[j].tagsOffset    = offset;
+            offset = align(offset + rows * sizeof(Cell::Tag));
+            entries[j].printsOffset = offset;
+            offset = align(offset + blocks * sizeof(uint64_t));
+            size_t position = 0;
+            columns[j].forEachSlice(
+                0,
+                rows,
+                [&](const double* numbers, const Cell::Tag* tags, size_t n) {
+                    for (size_t i = 0; i < n; ++i, ++position) {
+                        Cell cell =
+                            cellAt(columns[j], position, numbers[i], tags[i]);
+                        prints[j][position / Column::kChunkRows] ^=
+                            Column::fingerprint(
+                                cell, position % Column::kChunkRows);
+                        if (Cell::pooled(tags[i])) {
+                            const StringPool::Entry* text =
+                                Cell::entry(cell.payload);
+                            if (fileIds.emplace(text, texts.size()).second) {
+                                texts.push_back(text);
+                            }
+                        }
+                    }
+                });
+        }
+        header.dictionaryOffset = offset;
+        header.dictionaryCount  = texts.size();
+
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Не удалось записать файл: " + filename);
+        }
+        uint64_t written = sizeof(Header) + sizeof(Entry) * entries.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(entries.data()),
+                  static_cast<std::streamsize>(sizeof(Entry) * entries.size()));
+
+        // Второй проход: половины столбцов, адреса строк пула заменяются
+        // номерами строк словаря файла
+        std::vector<double> buffer;
+        for (size_t j = 0; j < columns.size(); ++j) {
+            pad(out, written, entries[j].numbersOffset);
+            size_t position = 0;
+            columns[j].forEachSlice(
+                0,
+                rows,
+                [&](const double* numbers, const Cell::Tag* tags, size_t n) {
+                    buffer.assign(numbers, numbers + n);
+                    for (size_t i = 0; i < n; ++i, ++position) {
+                        if (Cell::pooled(tags[i])) {
+                            Cell cell = cellAt(
+                                columns[j], position, numbers[i], tags[i]);
+                            uint64_t id =
+                                fileIds[Cell::entry(cell.payload)];
+                            std::memcpy(&buffer[i], &id, sizeof(double));
+                        }
+                    }
+                    out.write(reinterpret_cast<const char*>(buffer.data()),
+                              static_cast<std::streamsize>(n * sizeof(double)));
+                });
+            written += rows * sizeof(double);
+            pad(out, written, entries[j].tagsOffset);
+            columns[j].forEachSlice(
+                0,
+                rows,
+                [&](const double*, const Cell::Tag* tags, size_t n) {
+                    out.write(
+                        reinterpret_cast<const char*>(tags),
+                        static_cast<std::streamsize>(n * sizeof(Cell::Tag)));
+                });
+            written += rows * sizeof(Cell::Tag);
+            pad(out, written, entries[j].printsOffset);
+            out.write(reinterpret_cast<const char*>(prints[j].data()),
+                      static_cast<std::streamsize>(blocks * sizeof(uint64_t)));
+            written += blocks * sizeof(uint64_t);
+        }
+        pad(out, written, header.dictionaryOffset);
+
+        // Словарь: смещения начал строк, затем сами строки подряд
+        std::vector<uint64_t> starts(1, 0);
+        for (const StringPool::Entry* text : texts) {
+            starts.push_back(starts.back() + text->str().size());
+        }
+        out.write(reinterpret_cast<const char*>(starts.data()),
+                  static_cast<std::streamsize>(sizeof(uint64_t) *
+                                               starts.size()));
+        for (const StringPool::Entry* text : texts) {
+            out.write(text->str().data(),
+                      static_cast<std::streamsize>(text->str().size()));
+        }
+        if (!out.good()) {
+            throw std::runtime_error("Не удалось записать файл: " + filename);
+        }
+    }
+
+    static size_t open(const std::string&          filename,
+                       std::vector<Column>&        columns,
+                       std::vector<ColumnSummary>& summaries) { // Открытие
+                                                                // файла
+        std::shared_ptr<const MappedFile> file =
+            std::make_shared<const MappedFile>(filename);
+        const char* data = file->data();
+        uint64_t    size = file->size();
+
+        Header header;
+        if (size < sizeof(Header)) {
+            fail(filename);
+        }
+        std::memcpy(&header, data, sizeof(Header));
+        if (std::memcmp(header.magic, "TABLECOL", sizeof(header.magic)) != 0 ||
+            header.version != kVersion) {
+            fail(filename);
+        }
+        if (header.byteOrder != kByteOrder) {
+            throw std::runtime_error(
+                "Файл таблицы записан с другим порядком байтов: " + filename);
+        }
+        uint64_t plane = header.rows * sizeof(double);
+        if (header.rows > size / sizeof(double) ||
+            header.columns > (size - sizeof(Header)) / sizeof(Entry)) {
+            fail(filename);
+        }
+
+        // Ячейки и словарь остаются в файле: блоки проверяются, а строки
+        // словаря переносятся в пул при первом обращении к ним
+        uint64_t count = header.dictionaryCount;
+        uint64_t dictionary = header.dictionaryOffset;
+        if (dictionary > size || dictionary % sizeof(uint64_t) != 0 ||
+            count >= (size - dictionary) / sizeof(uint64_t)) {
+            fail(filename);
+        }
+        const uint64_t* starts =
+            reinterpret_cast<const uint64_t*>(data + dictionary);
+        const char* text = data + dictionary + sizeof(uint64_t) * (count + 1);
+        uint64_t    textSize = size - (text - data);
+        size_t blocks =
+            (header.rows + Column::kChunkRows - 1) / Column::kChunkRows;
+        std::shared_ptr<const Column::Chunk::Mapping> mapping =
+            std::make_shared<const Column::Chunk::Mapping>(
+                file,
+                filename,
+                starts,
+                text,
+                textSize,
+                count,
+                blocks * header.columns);
+
+        std::vector<Column> loaded(header.columns);
+        summaries.assign(header.columns, ColumnSummary());
+        for (size_t j = 0; j < header.columns; ++j) {
+            Entry entry;
+            std::memcpy(&entry,
+                        data + sizeof(Header) + sizeof(Entry) * j,
+                        sizeof(Entry));
+            if (entry.numbersOffset % kAlignment != 0 ||
+                entry.tagsOffset % kAlignment != 0 ||
+                entry.numbersOffset > size - plane ||
+                entry.tagsOffset > size - plane ||
+                entry.printsOffset % kAlignment != 0 ||
+                entry.printsOffset > size ||
+                (size - entry.printsOffset) / sizeof(uint64_t) < blocks) {
+                fail(filename);
+            }
+            summaries[j].numbers = entry.numbers;
+            summaries[j].min     = entry.min;
+            summaries[j].max     = entry.max;
+            summaries[j].sum     = entry.sum;
+
+            const double* numbers =
+                reinterpret_cast<const double*>(data + entry.numbersOffset);
+            const Cell::Tag* tags =
+                reinterpret_cast<const Cell::Tag*>(data + entry.tagsOffset);
+            const uint64_t* prints =
+                reinterpret_cast<const uint64_t*>(data + entry.printsOffset);
+            for (size_t i = 0; i < header.rows; i += Column::kChunkRows) {
+                size_t n = header.rows - i < Column::kChunkRows
+                               ? header.rows - i
+                               : Column::kChunkRows;
+                size_t k = i / Column::kChunkRows;
+                loaded[j].pushChunk(Column::Chunk(mapping,
+                                                  j * blocks + k,
+                                                  numbers + i,
+                                                  tags + i,
+                                                  n,
+                                                  prints[k]));
+            }
+        }
+        columns.swap(loaded);
+        return header.rows;
+    }
+};
+
+// Класс TextWriter - Буфер для вывода таблицы: текст собирается в строке и
+// передается потоку большими кусками, а числа форматируются std::to_chars
+// так же, как их выводит поток по умолчанию (%g, 6 значащих цифр).
+
+class TextWriter {
+private:
+    static const size_t kFlushBytes = 1 << 16; // Порог сброса буфера
+
+    std::ostream& os;     // Поток вывода
+    std::string   buffer; // Накопленный текст
+
+public:
+    static const size_t kNumberChars = 32; // Место под одно число
+
+    explicit TextWriter(std::ostream& stream) : os(stream) {
+        buffer.reserve(kFlushBytes + kFlushBytes / 4);
+    }
+
+    ~TextWriter() { flush(); }
+
+    TextWriter(const TextWriter&) = delete;
+    TextWriter& operator=(const TextWriter&) = delete;
+
+    static size_t number(double value,
+                         char*  out) { // Запись числа, возвращает длину
+        return std::to_chars(out,
+                             out + kNumberChars,
+                             value,
+                             std::chars_format::general,
+                             6)
+                   .ptr -
+               out;
+    }
+
+    void put(std::string_view text) { // Добавление текста
+        buffer.append(text.data(), text.size());
+        if (buffer.size() >= kFlushBytes) {
+            flush();
+        }
+    }
+
+    void put(std::string_view text,
+             size_t           width,
+             bool             left) { // Добавление текста, дополненного
+                                      // пробелами до ширины width
+        size_t padding = width > text.size() ? width - text.size() : 0;
+        if (!left) {
+            buffer.append(padding, ' ');
+        }
+        buffer.append(text.data(), text.size());
+        if (left) {
+            buffer.append(padding, ' ');
+        }
+        if (buffer.size() >= kFlushBytes) {
+            flush();
+        }
+    }
+
+    void flush() { // Передача накопленного текста потоку
+        os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+};
+
+// Структура Aggregation - Агрегат группировки: операция над столбцом.
+
+struct Aggregation {
+    size_t                 column; // Агрегируемый столбец
+    FormulaCell::Operation op;     // Операция
+};
+
+// Структура GroupOptions - Параметры группировки.
+
+struct GroupOptions {
+    size_t threads;      // Кол-во потоков (0 - по числу ядер)
+    size_t memoryBudget; // Предел памяти хеш-таблиц в байтах (0 - без
+                         // предела); не поместившиеся группы
+                         // досчитываются следующими проходами с диска
+    bool header;         // Первая строка - названия признаков
+
+    GroupOptions(size_t threadCount = 0,
+                 size_t budget      = 0,
+                 bool   hasHeader   = false)
+        : threads(threadCount), memoryBudget(budget), header(hasHeader) {}
+};
+
+// Класс HashAggregator - Группировка строк по ключевым столбцам с
+// вычислением агрегатов. Группы хранятся в хеш-таблице с открытой
+// адресацией (линейное пробирование), в ячейках которой рядом лежат хеш
+// ключа и номер группы. Строки делятся по старшим битам хеша на части,
+// которые агрегируются независимо в нескольких потоках. При бюджете памяти
+// хеши считаются окнами строк, а в каждой части помещается не больше
+// групп, чем позволяет бюджет: строки остальных групп откладываются вместе
+// с хешами в kFanout временных файлов по следующим битам хеша, и каждый
+// файл читается порциями следующим проходом. Строки каждой группы
+// учитываются в исходном порядке, поэтому результат не зависит от числа
+// потоков, а группы выводятся в порядке первого появления.
+
+class HashAggregator {
+private:
+    static const uint32_t kEmptySlot = UINT32_MAX; // Пустая ячейка таблицы
+    static constexpr size_t kFanout  = 16; // Кол-во файлов, по которым
+                                           // делятся отложенные строки
+                                           // прохода
+    static constexpr size_t kSpillRows  = 4096;    // Строк в буфере файла
+    static constexpr size_t kWindowRows = 1 << 14; // Строк в окне хешей при
+                                                   // бюджете памяти
+
+    struct Slot {       // Ячейка хеш-таблицы
+        uint64_t hash;  // Хеш ключа
+        uint32_t group; // Номер группы (kEmptySlot - свободна)
+    };
+
+    struct Groups {                    // Группы, найденные одной частью
+        std::vector<Column> columns;   // Ключи и агрегаты по группам
+        std::vector<size_t> firstRows; // Первая строка каждой группы
+    };
+
+    struct Spilled {   // Отложенная строка
+        uint64_t row;  // Номер строки
+        uint64_t hash; // Хеш ключа
+    };
+
+    struct Closer {
+        void operator()(std::FILE* file) const { std::fclose(file); }
+    }; // Закрытие временного файла
+
+    typedef std::unique_ptr<std::FILE, Closer>
+        SpillFile; // Временный файл отложенных строк
+
+    struct Pending {       // Файл отложенных строк, ждущий прохода
+        SpillFile file;    // Строки в порядке номеров
+        size_t    depth;   // Глубина прохода, который его прочитает
+    };
+
+    class Pass { // Проход агрегации: не больше maxGroups групп в памяти,
+                 // строки остальных групп - во временных файлах
+    public:
+        Pass(const HashAggregator& owner, size_t limit, size_t level)
+            : aggregator(owner),
+              maxGroups(limit),
+              depth(level),
+              slots(16, Slot{0, kEmptySlot}),
+              files(kFanout),
+              buffers(kFanout) {}
+
+        void feed(size_t row, uint64_t hash) { // Учет очередной строки
+            const std::vector<size_t>& keys = aggregator.keys;
+            const std::vector<Aggregation>& aggregations =
+                aggregator.aggregations;
+            size_t mask = slots.size() - 1;
+            size_t at   = hash & mask;
+            while (slots[at].group != kEmptySlot &&
+                   (slots[at].hash != hash ||
+                    !aggregator.sameKey(keyCells, slots[at].group, row))) {
+                at = (at + 1) & mask;
+            }
+            uint32_t group = slots[at].group;
+            if (group == kEmptySlot) {
+                if (firstRows.size() >= maxGroups) { // Группа не помещается
+                    size_t file = Cell::mix(hash + depth) >> 60;
+                    buffers[file].push_back(Spilled{row, hash});
+                    if (buffers[file].size() >= kSpillRows) {
+                        spill(file);
+                    }
+                    return;
+                }
+                group     = static_cast<uint32_t>(firstRows.size());
+                slots[at] = Slot{hash, group};
+                firstRows.push_back(row);
+                for (size_t key : keys) {
+                    keyCells.push_back(aggregator.columns[key].get(row));
+                }
+                for (const Aggregation& aggregation : aggregations) {
+                    states.push_back(FormulaCell::Accumulator(aggregation.op));
+                }
+                if (2 * firstRows.size() > slots.size()) {
+                    rehash(slots);
+                }
+            }
+            for (size_t a = 0; a < aggregations.size(); ++a) {
+                const Column& column =
+                    aggregator.columns[aggregations[a].column];
+                FormulaCell::Accumulator& state =
+                    states[group * aggregations.size() + a];
+                state.check(column.getType(row));
+                state.add(column.getNumber(row));
+            }
+        }
+
+        void finish(Groups&               out,
+                    std::vector<Pending>& pending) { // Вывод групп прохода;
+                                                     // непустые файлы
+                                                     // отложенных строк
+                                                     // ждут своих проходов
+            size_t keyCount = aggregator.keys.size();
+            size_t aggregateCount = aggregator.aggregations.size();
+            for (size_t g = 0; g < firstRows.size(); ++g) {
+                for (size_t k = 0; k < keyCount; ++k) {
+                    out.columns[k].push(keyCells[g * keyCount + k]);
+                }
+                for (size_t a = 0; a < aggregateCount; ++a) {
+                    out.columns[keyCount + a].push(
+                        Cell(states[g * aggregateCount + a].result()));
+                }
+            }
+            out.firstRows.insert(
+                out.firstRows.end(), firstRows.begin(), firstRows.end());
+            for (size_t file = 0; file < kFanout; ++file) {
+                spill(file);
+                if (files[file]) {
+                    std::rewind(files[file].get());
+                    pending.push_back(
+                        Pending{std::move(files[file]), depth + 1});
+                }
+            }
+        }
+
+    private:
+        const HashAggregator&                 aggregator; // Группировка
+        size_t                                maxGroups;  // Предел групп
+        size_t                                depth;      // Глубина прохода
+        std::vector<Slot>                     slots;      // Хеш-таблица
+        std::vector<Cell>                     keyCells;   // Ключи групп
+        std::vector<FormulaCell::Accumulator> states;     // Агрегаты групп
+        std::vector<size_t>                   firstRows;  // Первые строки
+                                                          // групп
+        std::vector<SpillFile>                files;      // Отложенные
+                                                          // строки
+        std::vector<std::vector<Spilled> >    buffers;    // Еще не
+                                                          // записанные
+                                                          // отложенные строки
+
+        void spill(size_t file) { // Дозапись буфера во временный файл
+            std::vector<Spilled>& buffer = buffers[file];
+            if (buffer.empty()) {
+                return;
+            }
+            if (!files[file]) {
+                files[file].reset(std::tmpfile());
+                if (!files[file]) {
+                    throw std::runtime_error(
+                        "Не удалось создать временный файл группировки.");
+                }
+            }
+            size_t written = std::fwrite(buffer.data(),
+                                         sizeof(Spilled),
+                                         buffer.size(),
+                                         files[file].get());
+            if (written != buffer.size()) {
+                throw std::runtime_error(
+                    "Не удалось записать временный файл группировки.");
+            }
+            Stats::add(Stats::GROUP_SPILLED_ROWS, buffer.size());
+            buffer.clear();
+        }
+    };
+
+    const std::vector<Column>&      columns;      // Столбцы таблицы
+    const std::vector<size_t>&      keys;         // Ключевые столбцы
+    const std::vector<Aggregation>& aggregations; // Агрегаты
+
+    size_t groupBytes() const { // Оценка памяти на одну группу
+        return 2 * sizeof(Slot) + keys.size() * sizeof(Cell) +
+               aggregations.size() * sizeof(FormulaCell::Accumulator) +
+               sizeof(size_t);
+    }
+
+    uint64_t hashOf(size_t row) const { // Хеш ключа строки
+        uint64_t hash = 0;
+        for (size_t key : keys) {
+            hash = Cell::mix(hash ^ columns[key].get(row).hash());
+        }
+        return hash;
+    }
+
+    bool sameKey(const std::vector<Cell>& keyCells,
+                 uint32_t                 group,
+                 size_t row) const { // Совпадает ли ключ строки с ключом
+                                     // группы
+        for (size_t k = 0; k < keys.size(); ++k) {
+            if (keyCells[group * keys.size() + k] !=
+                columns[keys[k]].get(row)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void drain(std::vector<Pending>& pending,
+               size_t                maxGroups,
+               Groups& out) const { // Проходы по отложенным строкам; файл
+                                    // читается порциями по kSpillRows строк
+        std::vector<Spilled> buffer(kSpillRows);
+        while (!pending.empty()) {
+            Pending item = std::move(pending.back());
+            pending.pop_back();
+            Pass   pass(*this, maxGroups, item.depth);
+            size_t n;
+            while ((n = std::fread(buffer.data(),
+                                   sizeof(Spilled),
+                                   buffer.size(),
+                                   item.file.get())) > 0) {
+                for (size_t i = 0; i < n; ++i) {
+                    pass.feed(buffer[i].row, buffer[i].hash);
+                }
+            }
+            item.file.reset();
+            pass.finish(out, pending);
+        }
+    }
+
+    std::vector<Groups> inMemory(size_t rowFrom,
+                                 size_t rowEnd,
+                                 size_t threads) const { // Группировка без
+                                                         // предела памяти
+        // Хеши ключей считаются параллельно по участкам строк
+        std::vector<uint64_t> hashes(rowEnd - rowFrom);
+        size_t step = (rowEnd - rowFrom + threads - 1) / threads;
+        Parallel::run(threads, [&](size_t t) {
+            size_t from = rowFrom + t * step;
+            size_t to   = std::min(rowEnd, from + step);
+            for (size_t row = from; row < to; ++row) {
+                hashes[row - rowFrom] = hashOf(row);
+            }
+        });
+
+        // Строки раскладываются по частям по старшим битам хеша
+        size_t bits = 0;
+        while (threads > 1 && (size_t(1) << bits) < 4 * threads) {
+            ++bits;
+        }
+        std::vector<std::vector<size_t> > parts(size_t(1) << bits);
+        for (size_t row = rowFrom; row < rowEnd; ++row) {
+            uint64_t hash = hashes[row - rowFrom];
+            parts[bits ? hash >> (64 - bits) : 0].push_back(row);
+        }
+
+        std::vector<Groups> found(parts.size());
+        std::atomic<size_t> next(0);
+        Parallel::run(threads, [&](size_t) {
+            for (size_t p = next++; p < parts.size(); p = next++) {
+                found[p].columns.assign(keys.size() + aggregations.size(),
+                                        Column());
+                Pass                 pass(*this, SIZE_MAX, 0);
+                std::vector<Pending> pending; // Остается пустым
+                for (size_t row : parts[p]) {
+                    pass.feed(row, hashes[row - rowFrom]);
+                }
+                std::vector<size_t>().swap(parts[p]);
+                pass.finish(found[p], pending);
+            }
+        });
+        return found;
+    }
+
+    std::vector<Groups> bounded(
+        size_t rowFrom,
+        size_t rowEnd,
+        size_t threads,
+        size_t maxGroups) const { // Группировка в пределах памяти: у
+                                  // каждого потока своя часть строк и не
+                                  // больше maxGroups групп в памяти
+        std::vector<Groups> found(threads);
+        std::vector<Pass>   passes;
+        passes.reserve(threads);
+        for (size_t t = 0; t < threads; ++t) {
+            found[t].columns.assign(keys.size() + aggregations.size(),
+                                    Column());
+            passes.push_back(Pass(*this, maxGroups, 0));
+        }
+        std::vector<uint64_t> window(kWindowRows); // Хеши окна строк
+        for (size_t from = rowFrom; from < rowEnd; from += kWindowRows) {
+            size_t n    = std::min(kWindowRows, rowEnd - from);
+            size_t step = (n + threads - 1) / threads;
+            Parallel::run(threads, [&](size_t t) {
+                for (size_t i = t * step; i < std::min(n, (t + 1) * step);
+                     ++i) {
+                    window[i] = hashOf(from + i);
+                }
+            });
+            Parallel::run(threads, [&](size_t t) {
+                for (size_t i = 0; i < n; ++i) {
+                    if ((window[i] >> 32) % threads == t) {
+                        passes[t].feed(from + i, window[i]);
+                    }
+                }
+            });
+        }
+        Parallel::run(threads, [&](size_t t) {
+            std::vector<Pending> pending;
+            passes[t].finish(found[t], pending);
+            drain(pending, maxGroups, found[t]);
+        });
+        return found;
+    }
+
+    static void rehash(std::vector<Slot>& slots) { // Удвоение хеш-таблицы
+        std::vector<Slot> grown(slots.size() * 2, Slot{0, kEmptySlot});
+        size_t            mask = grown.size() - 1;
+        for (const Slot& slot : slots) {
+            if (slot.group == kEmptySlot) {
+                continue;
+            }
+            size_t at = slot.hash & mask;
+            while (grown[at].group != kEmptySlot) {
+                at = (at + 1) & mask;
+            }
+            grown[at] = slot;
+        }
+        slots.swap(grown);
+    }
+
+public:
+    HashAggregator(const std::vector<Column>&      tableColumns,
+                   const std::vector<size_t>&      keyColumns,
+                   const std::vector<Aggregation>& aggregates)
+        : columns(tableColumns), keys(keyColumns), aggregations(aggregates) {}
+
+    size_t run(size_t               rowFrom,
+               size_t               rowEnd,
+               const GroupOptions&  options,
+               std::vector<Column>& result) { // Группировка строк
+                                              // [rowFrom, rowEnd), результат
+                                              // - ключи и агрегаты по
+                                              // группам; возвращает кол-во
+                                              // групп
+        size_t threads =
+            options.threads > 0 ? options.threads : Parallel::hardwareThreads();
+        threads = std::max<size_t>(
+            1, std::min(threads, (rowEnd - rowFrom) / (1 << 14)));
+
+        std::vector<Groups> found;
+        if (options.memoryBudget > 0) {
+            size_t maxGroups = std::max<size_t>(
+                1, options.memoryBudget / threads / groupBytes());
+            found = bounded(rowFrom, rowEnd, threads, maxGroups);
+        } else {
+            found = inMemory(rowFrom, rowEnd, threads);
+        }
+
+        // Группы всех частей упорядочиваются по первой строке
+        std::vector<std::pair<size_t, std::pair<size_t, size_t> > > order;
+        for (size_t p = 0; p < found.size(); ++p) {
+            for (size_t g = 0; g < found[p].firstRows.size(); ++g) {
+                order.push_back(std::make_pair(found[p].firstRows[g],
+                                               std::make_pair(p, g)));
+            }
+        }
+        std::sort(order.begin(), order.end());
+        for (size_t c = 0; c < keys.size() + aggregations.size(); ++c) {
+            for (const auto& item : order) {
+                const Groups& groups = found[item.second.first];
+                result[c].push(groups.columns[c].get(item.second.second));
+            }
+        }
+        return order.size();
+    }
+};
+
+// Класс Predicate - Условие отбора строк: сравнение числа с границей,
+// равенство или начало текста, пустота ячейки и их сочетания через И/ИЛИ.
+// Условие вычисляется по столбцам окнами строк: для окна строится маска
+// подходящих строк, сравнения чисел выполняются векторным ядром над
+// непрерывными участками блоков столбца.
+
+class Predicate {
+private:
+    enum Kind { COMPARE, TEXT_EQUAL, TEXT_PREFIX, IS_EMPTY, ALL, ANY };
+
+    Kind                   kind;       // Вид условия
+    size_t                 column;     // Проверяемый столбец
+    Kernels::Comparison    comparison; // Сравнение (для COMPARE)
+    double                 bound;      // Граница (для COMPARE)
+    std::string            text;       // Текст (для TEXT_EQUAL и TEXT_PREFIX);
+                                       // хранится строкой, чтобы запросы не
+                                       // пополняли пул строк
+    std::vector<Predicate> parts;      // Части сочетания (для ALL и ANY)
+
+    Predicate(Kind type, size_t col)
+        : kind(type), column(col), comparison(Kernels::EQUAL), bound(0) {}
+
+    static Predicate compare(size_t              col,
+                             Kernels::Comparison type,
+                             double              value) { // Сравнение числа
+        Predicate predicate(COMPARE, col);
+        predicate.comparison = type;
+        predicate.bound      = value;
+        return predicate;
+    }
+
+    static Predicate join(Kind             type,
+                          const Predicate& left,
+                          const Predicate& right) { // Сочетание условий;
+                                                    // вложенные сочетания
+                                                    // того же вида
+                                                    // разворачиваются
+        Predicate predicate(type, 0);
+        for (const Predicate* part : {&left, &right}) {
+            if (part->kind == type) {
+                predicate.parts.insert(predicate.parts.end(),
+                                       part->parts.begin(),
+                                       part->parts.end());
+            } else {
+                predicate.parts.push_back(*part);
+            }
+        }
+        return predicate;
+    }
+
+    template <class Test>
+    void matchText(const Column& cells,
+                   size_t        from,
+                   size_t        n,
+                   Test          test,
+                   uint8_t* mask) const { // Проверка текстовых ячеек окна
+        size_t done = 0;
+        cells.forEachSlice(
+            from,
+            from + n,
+            [&](const double*, const Cell::Tag* tags, size_t count) {
+                for (size_t i = 0; i < count; ++i, ++done) {
+                    mask[done] = tags[i].type == Cell::TEXT &&
+                                 test(cells.get(from + done));
+                }
+            });
+    }
+
+public:
+    static Predicate less(size_t col, double value) {
+        return compare(col, Kernels::LESS, value);
+    } // Число столбца col меньше value
+    static Predicate lessEqual(size_t col, double value) {
+        return compare(col, Kernels::LESS_EQUAL, value);
+    } // Число столбца col не больше value
+    static Predicate greater(size_t col, double value) {
+        return compare(col, Kernels::GREATER, value);
+    } // Число столбца col больше value
+    static Predicate greaterEqual(size_t col, double value) {
+        return compare(col, Kernels::GREATER_EQUAL, value);
+    } // Число столбца col не меньше value
+    static Predicate equal(size_t col, double value) {
+        return compare(col, Kernels::EQUAL, value);
+    } // Число столбца col равно value
+    static Predicate notEqual(size_t col, double value) {
+        return compare(col, Kernels::NOT_EQUAL, value);
+    } // Число столбца col не равно value
+
+    static Predicate equal(size_t           col,
+                           std::string_view value) { // Текст столбца col
+                                                     // равен value
+        Predicate predicate(TEXT_EQUAL, col);
+        predicate.text = std::string(value);
+        return predicate;
+    }
+
+    static Predicate startsWith(size_t           col,
+                                std::string_view prefix) { // Текст столбца
+                                                           // col начинается
+                                                           // с prefix
+        Predicate predicate(TEXT_PREFIX, col);
+        predicate.text = std::string(prefix);
+        return predicate;
+    }
+
+    static Predicate isEmpty(size_t col) {
+        return Predicate(IS_EMPTY, col);
+    } // Ячейка столбца col пуста
+
+    friend Predicate operator&&(const Predicate& left,
+                                const Predicate& right) {
+        return join(ALL, left, right);
+    } // Выполнены оба условия
+    friend Predicate operator||(const Predicate& left,
+                                const Predicate& right) {
+        return join(ANY, left, right);
+    } // Выполнено хотя бы одно условие
+
+    void check(size_t columnCount) const { // Проверка номеров столбцов
+        if (kind == ALL || kind == ANY) {
+            for (const Predicate& part : parts) {
+                part.check(columnCount);
+            }
+        } else if (column >= columnCount) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+    }
+
+    void evaluate(const std::vector<Column>& columns,
+                  size_t                     from,
+                  size_t                     n,
+                  uint8_t* mask) const { // Маска строк [from, from + n):
+                                         // mask[i] = 1, если строка from + i
+                                         // удовлетворяет условию
+        switch (kind) {
+            case COMPARE: {
+                const Kernels& kernels = Kernels::instance();
+                size_t         done    = 0;
+                columns[column].forEachSlice(
+                    from,
+                    from + n,
+                    [&](const double*    numbers,
+                        const Cell::Tag* tags,
+                        size_t           count) {
+                        kernels.compare(
+                            numbers, tags, count, comparison, bound,
+                            mask + done);
+                        done += count;
+                    });
+                return;
+            }
+            case TEXT_EQUAL: {
+                std::string_view value = text;
+                return matchText(
+                    columns[column], from, n,
+                    [value](const Cell& cell) {
+                        return cell.getTextView() == value;
+                    },
+                    mask);
+            }
+            case TEXT_PREFIX: {
+                std::string_view prefix = text;
+                return matchText(
+                    columns[column], from, n,
+                    [prefix](const Cell& cell) {
+                        return cell.getTextView().substr(0, prefix.size()) ==
+                               prefix;
+                    },
+                    mask);
+            }
+            case IS_EMPTY: {
+                size_t done = 0;
+                columns[column].forEachSlice(
+                    from,
+                    from + n,
+                    [&](const double*, const Cell::Tag* tags, size_t count) {
+                        for (size_t i = 0; i < count; ++i) {
+                            mask[done++] = tags[i].type == Cell::EMPTY;
+                        }
+                    });
+                return;
+            }
+            case ALL:
+            case ANY: {
+                parts[0].evaluate(columns, from, n, mask);
+                std::vector<uint8_t> other(n);
+                for (size_t k = 1; k < parts.size(); ++k) {
+                    size_t hits = 0; // Досрочный выход, если исход окна
+                                     // уже известен
+                    for (size_t i = 0; i < n; ++i) {
+                        hits += mask[i];
+                    }
+                    if ((kind == ALL && hits == 0) ||
+                        (kind == ANY && hits == n)) {
+                        return;
+                    }
+                    parts[k].evaluate(columns, from, n, other.data());
+                    if (kind == ALL) {
+                        for (size_t i = 0; i < n; ++i) {
+                            mask[i] &= other[i];
+                        }
+                    } else {
+                        for (size_t i = 0; i < n; ++i) {
+                            mask[i] |= other[i];
+                        }
+                    }
+                }
+                return;
+            }
+        }
+    }
+};
+
+// Структура SortKey - Ключ сортировки: столбец и направление.
+
+struct SortKey {
+    size_t column;    // Столбец
+    bool   ascending; // По возрастанию (иначе по убыванию)
+};
+
+// Структура SortOptions - Параметры сортировки.
+
+struct SortOptions {
+    size_t threads; // Кол-во потоков (0 - по числу ядер)
+    bool   header;  // Первая строка - названия признаков, не сортируется
+
+    SortOptions(size_t threadCount = 0, bool hasHeader = false)
+        : threads(threadCount), header(hasHeader) {}
+};
+
+// Класс RowSorter - Упорядочивание строк таблицы: результат -
+// перестановка номеров строк, сами ячейки не перемещаются. Каждый ключ
+// переводится в 64-битные коды, порядок которых совпадает с порядком
+// значений: числа - по битам IEEE-754 (у отрицательных биты обращены),
+// текст - по номеру строки в отсортированном словаре различных значений
+// столбца. Коды упорядочиваются поразрядной сортировкой (LSD, по байту за
+// проход), устойчивой, поэтому ключи обрабатываются от последнего к
+// первому. Проходы делятся между потоками по участкам массива. Числа идут
+// перед текстом, пустые ячейки - в конце при любом направлении.
+
+class RowSorter {
+private:
+    const std::vector<Column>& columns; // Столбцы таблицы
+    size_t                     rowFrom; // Первая сортируемая строка
+    size_t                     rowEnd;  // Конец сортируемых строк
+    size_t                     threads; // Кол-во потоков
+
+    static uint64_t numberCode(double value) { // Код числа
+        uint64_t bits;
+        value = value == 0 ? 0.0 : value; // -0 == 0
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits >> 63 ? ~bits : bits | (uint64_t(1) << 63);
+    }
+
+    void encode(const SortKey&         key,
+                std::vector<uint64_t>& codes,
+                std::vector<uint8_t>&  ranks) const { // Коды значений и
+                                                      // ранги типов строк
+        const Column& cells = columns[key.column];
+        size_t        n     = rowEnd - rowFrom;
+        codes.assign(n, 0);
+        ranks.assign(n, 2); // Числа, затем текст, пустые ячейки - в конце
+        std::unordered_map<Cell, uint32_t, Cell::Hash> ids; // Текст -> номер
+        std::vector<const Cell*>                        texts;
+        std::vector<uint32_t>                           textIds(n);
+        for (size_t i = 0; i < n; ++i) {
+            Cell cell = cells.get(rowFrom + i);
+            if (cell.getType() == Cell::NUMBER) {
+                codes[i] = numberCode(cell.getNumber());
+                ranks[i] = 0;
+            } else if (cell.getType() == Cell::TEXT) {
+                auto found = ids.emplace(cell, texts.size());
+                if (found.second) {
+                    texts.push_back(&found.first->first);
+                }
+                textIds[i] = found.first->second;
+                ranks[i]   = 1;
+            }
+        }
+        if (!texts.empty()) { // Словарь столбца упорядочивается по тексту
+            std::vector<uint32_t> sorted(texts.size());
+            for (uint32_t k = 0; k < sorted.size(); ++k) {
+                sorted[k] = k;
+            }
+            std::sort(
+                sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b) {
+                    return texts[a]->getTextView() < texts[b]->getTextView();
+                });
+            std::vector<uint64_t> places(texts.size());
+            for (uint32_t k = 0; k < sorted.size(); ++k) {
+                places[sorted[k]] = k;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                if (ranks[i] == 1) {
+                    codes[i] = places[textIds[i]];
+                }
+            }
+        }
+        if (!key.ascending) {
+            for (uint64_t& code : codes) {
+                code = ~code;
+            }
+        }
+    }
+
+    void pass(std::vector<uint64_t>& keys,
+              std::vector<size_t>&   rows,
+              std::vector<uint64_t>& keysOut,
+              std::vector<size_t>&   rowsOut,
+              unsigned shift) const { // Устойчивая раскладка по байту
+                                      // ключа; пропускается, если байт у
+                                      // всех строк одинаков
+        size_t              n    = keys.size();
+        size_t              step = (n + threads - 1) / threads;
+        std::vector<size_t> counts(threads * 256, 0);
+        Parallel::run(threads, [&](size_t t) {
+            size_t* count = &counts[t * 256];
+            for (size_t i = t * step; i < std::min(n, (t + 1) * step); ++i) {
+                ++count[(keys[i] >> shift) & 0xFF];
+            }
+        });
+        size_t offset = 0;
+        for (size_t b = 0; b < 256; ++b) { // Начала участков потоков
+            size_t total = 0;
+            for (size_t t = 0; t < threads; ++t) {
+                total += counts[t * 256 + b];
+            }
+            if (total == n) {
+                return;
+            }
+            for (size_t t = 0; t < threads; ++t) {
+                size_t count        = counts[t * 256 + b];
+                counts[t * 256 + b] = offset;
+                offset += count;
+            }
+        }
+        keysOut.resize(n);
+        rowsOut.resize(n);
+        Parallel::run(threads, [&](size_t t) {
+            size_t* place = &counts[t * 256];
+            for (size_t i = t * step; i < std::min(n, (t + 1) * step); ++i) {
+                size_t at   = place[(keys[i] >> shift) & 0xFF]++;
+                keysOut[at] = keys[i];
+                rowsOut[at] = rows[i];
+            }
+        });
+        keys.swap(keysOut);
+        rows.swap(rowsOut);
+    }
+
+public:
+    RowSorter(const std::vector<Column>& tableColumns,
+              size_t                     firstRow,
+              size_t                     endRow,
+              size_t                     threadCount)
+        : columns(tableColumns), rowFrom(firstRow), rowEnd(endRow) {
+        threads = threadCount > 0 ? threadCount : Parallel::hardwareThreads();
+        threads = std::max<size_t>(
+            1, std::min(threads, (rowEnd - rowFrom) / (1 << 16)));
+    }
+
+    std::vector<size_t> sort(
+        const std::vector<SortKey>& keys) const { // Номера строк в порядке
+                                                  // ключей
+        size_t              n = rowEnd - rowFrom;
+        std::vector<size_t> rows(n), rowsOut;
+        for (size_t i = 0; i < n; ++i) {
+            rows[i] = rowFrom + i;
+        }
+        std::vector<uint64_t> codes, sorted, sortedOut;
+        std::vector<uint8_t>  ranks;
+        for (size_t k = keys.size(); k-- > 0;) {
+            encode(keys[k], codes, ranks);
+            sorted.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                sorted[i] = codes[rows[i] - rowFrom];
+            }
+            for (unsigned shift = 0; shift < 64; shift += 8) {
+                pass(sorted, rows, sortedOut, rowsOut, shift);
+            }
+            for (size_t i = 0; i < n; ++i) { // Тип - старший разряд ключа
+                sorted[i] = ranks[rows[i] - rowFrom];
+            }
+            pass(sorted, rows, sortedOut, rowsOut, 0);
+        }
+        return rows;
+    }
+
+    std::vector<size_t> top(const SortKey& key,
+                            size_t k) const { // Номера k первых строк в
+                                              // порядке ключа
+        std::vector<uint64_t> codes;
+        std::vector<uint8_t>  ranks;
+        encode(key, codes, ranks);
+        std::vector<size_t> order(codes.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        k = std::min(k, order.size());
+        std::partial_sort(
+            order.begin(), order.begin() + k, order.end(),
+            [&](size_t a, size_t b) {
+                if (ranks[a] != ranks[b]) {
+                    return ranks[a] < ranks[b];
+                }
+                return codes[a] != codes[b] ? codes[a] < codes[b] : a < b;
+            });
+        order.resize(k);
+        for (size_t& i : order) {
+            i += rowFrom;
+        }
+        return order;
+    }
+};
+
+// Класс ColumnIndex - Вторичный индекс столбца. Хеш-индекс хранит для
+// каждого значения (текста или числа) номера строк с ним по возрастанию и
+// находит строки по значению за O(1). Упорядоченный индекс хранит пары
+// (число, строка) в сбалансированном дереве и находит строки с числами из
+// диапазона за O(log n). Обе части обновляются по одной ячейке при ее
+// изменении. Пустые ячейки и NaN не индексируются.
+
+class ColumnIndex {
+public:
+    enum Kind { HASH, ORDERED }; // Виды индекса
+
+private:
+    bool hashed;  // Построен ли хеш-индекс
+    bool ordered; // Построен ли упорядоченный индекс
+    std::unordered_map<Cell, std::vector<size_t>, Cell::Hash>
+        positions; // Значение -> номера строк по возрастанию
+    std::set<std::pair<double, size_t> > numbers; // Числа столбца и строки
+
+    static double key(const Cell& cell) { // Число ячейки (-0 == 0)
+        return cell.getNumber() == 0 ? 0.0 : cell.getNumber();
+    }
+
+    static bool indexable(const Cell& cell) { // Учитывается ли ячейка
+        return cell.getType() == Cell::TEXT ||
+               (cell.getType() == Cell::NUMBER &&
+                !std::isnan(cell.getNumber()));
+    }
+
+public:
+    ColumnIndex() : hashed(false), ordered(false) {}
+
+    bool has(Kind kind) const {
+        return kind == HASH ? hashed : ordered;
+    } // Построена ли часть kind
+    bool empty() const { return !hashed && !ordered; } // Нет ни одной части
+
+    void enable(Kind          kind,
+                const Column& cells,
+                size_t        rows) { // Построение части kind по столбцу
+        if (has(kind)) {
+            return;
+        }
+        (kind == HASH ? hashed : ordered) = true;
+        for (size_t i = 0; i < rows; ++i) {
+            Cell cell = cells.get(i);
+            if (!indexable(cell)) {
+                continue;
+            }
+            if (kind == HASH) {
+                positions[cell].push_back(i);
+            } else if (cell.getType() == Cell::NUMBER) {
+                numbers.emplace(key(cell), i);
+            }
+        }
+    }
+
+    void disable(Kind kind) { // Удаление части kind
+        if (kind == HASH) {
+            hashed = false;
+            positions.clear();
+        } else {
+            ordered = false;
+            numbers.clear();
+        }
+    }
+
+    void insert(size_t row, const Cell& cell) { // Учет ячейки строки row
+        if (!indexable(cell)) {
+            return;
+        }
+        if (hashed) {
+            std::vector<size_t>& rows = positions[cell];
+            if (rows.empty() || rows.back() < row) {
+                rows.push_back(row);
+            } else {
+                rows.insert(std::lower_bound(rows.begin(), rows.end(), row),
+                            row);
+            }
+        }
+        if (ordered && cell.getType() == Cell::NUMBER) {
+            numbers.emplace(key(cell), row);
+        }
+    }
+
+    void erase(size_t row, const Cell& cell) { // Удаление ячейки строки row
+        if (!indexable(cell)) {
+            return;
+        }
+        if (hashed) {
+            auto found = positions.find(cell);
+            if (found != positions.end()) {
+                std::vector<size_t>& rows = found->second;
+                auto at = std::lower_bound(rows.begin(), rows.end(), row);
+                if (at != rows.end() && *at == row) {
+                    rows.erase(at);
+                }
+                if (rows.empty()) {
+                    positions.erase(found);
+                }
+            }
+        }
+        if (ordered && cell.getType() == Cell::NUMBER) {
+            numbers.erase(std::make_pair(key(cell), row));
+        }
+    }
+
+    std::vector<size_t> find(
+        const Cell& value) const { // Строки со значением value по
+                                   // возрастанию (нужен хеш-индекс)
+        auto found = positions.find(value);
+        return found == positions.end() ? std::vector<size_t>()
+                                        : found->second;
+    }
+
+    std::vector<size_t> range(double low,
+                              double high) const { // Строки с числами из
+                                                   // [low, high] по
+                                                   // возрастанию (нужен
+                                                   // упорядоченный индекс)
+        std::vector<size_t> rows;
+        for (auto at = numbers.lower_bound(std::make_pair(low, size_t(0)));
+             at != numbers.end() && at->first <= high;
+             ++at) {
+            rows.push_back(at->second);
+        }
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    }
+};
+
+// Структура CellRange - Прямоугольный диапазон ячеек, границы включаются.
+
+struct CellRange {
+    size_t rowFrom; // Первая строка
+    size_t colFrom; // Первый столбец
+    size_t rowTo;   // Последняя строка
+    size_t colTo;   // Последний столбец
+
+    CellRange(size_t firstRow, size_t firstCol, size_t lastRow, size_t lastCol)
+        : rowFrom(firstRow), colFrom(firstCol), rowTo(lastRow), colTo(lastCol) {
+    }
+
+    bool operator==(const CellRange& other) const {
+        return rowFrom == other.rowFrom && colFrom == other.colFrom &&
+               rowTo == other.rowTo && colTo == other.colTo;
+    }
+};
+
+// Класс Table - Таблица: хранение ячеек и вычисления операций над ними.
+// Ячейки хранятся по столбцам: каждый столбец - непрерывные типизированные
+// массивы, поэтому проход по диапазону идет подряд по памяти.
+class Table {
+private:
+    static const size_t kPieceCells =
+        4 * Column::kChunkRows; // Размер части диапазона при пересчете
+    std::vector<Column> columns; // Столбцы таблицы
+    size_t              row;     // Кол-во строк
+    size_t              column;  // Кол-во столбцов
+
+    bool indexEnabled;     // Включен ли индекс префиксных сумм
+    bool indexWithProduct; // Нужна ли в индексе приближенная часть для
+                           // PRODUCT
+    std::shared_ptr<const PrefixIndex>
+        prefixIndex; // Индекс префиксных сумм (пуст, если устарел)
+    std::vector<ColumnSummary>
+        summaries; // Сводки по столбцам (пусты, если устарели)
+    FormulaGraph formulas; // Формулы, хранящиеся в ячейках
+    std::vector<size_t>
+        widths; // Ширина столбцов при выводе (kUnknownWidth - не известна)
+    std::vector<std::shared_ptr<ColumnIndex> >
+        indexes; // Вторичные индексы столбцов (пусто - индекса нет); общие
+                 // для копий таблицы, пока одна из них не изменит столбец
+    std::shared_ptr<const std::unordered_map<std::string, size_t> >
+        names; // Название признака -> номер столбца (пусто, если устарело)
+
+    static constexpr size_t kFilterRows = 4096; // Строк в окне отбора
+    static constexpr size_t kUnknownWidth = static_cast<size_t>(-1);
+
+    void invalidateCaches() { // Сброс данных, зависящих от содержимого
+        prefixIndex.reset();
+        summaries.clear();
+    }
+
+    void recalculate(const std::vector<FormulaGraph::Key>&
+                         cells) { // Пересчет формул в заданном порядке; если
+                                  // формулу посчитать нельзя, ее ячейка
+                                  // становится пустой
+        for (const FormulaGraph::Key& cell : cells) {
+            const FormulaGraph::Formula& formula =
+                *formulas.find(cell.first, cell.second);
+            Cell value;
+            try {
+                value = Cell(FormulaCell(getView(formula.rowFrom,
+                                                 formula.colFrom,
+                                                 formula.rowTo,
+                                                 formula.colTo),
+                                         formula.op,
+                                         formula.precision)
+                                 .compute());
+            } catch (const std::runtime_error&) {
+                value = Cell();
+            }
+            storeCell(cell.first, cell.second, value);
+        }
+        if (!cells.empty()) {
+            invalidateCaches();
+        }
+    }
+
+    void recalculateParallel(const std::vector<FormulaGraph::Key>& cells,
+                             size_t threads) { // Пересчет формул в пуле
+                                               // потоков
+        struct Slice {                 // Непрерывный участок диапазона
+            const double*    numbers; // Числа участка
+            const Cell::Tag* tags;    // Типы ячеек участка
+            size_t           n;       // Кол-во ячеек
+        };
+        struct Job {                             // Пересчет одной формулы
+            const FormulaGraph::Formula* formula; // Формула
+            FormulaGraph::Key            cell;     // Ячейка формулы
+            std::vector<Slice>           slices;   // Участки диапазона
+            std::vector<double>          partials; // Свертки участков
+            std::vector<size_t>          pieces;   // Границы частей
+            std::vector<size_t>          readers;  // Зависящие формулы
+            std::atomic<size_t>          inputs;   // Непосчитанные входы
+            std::atomic<size_t>          remaining; // Непосчитанные части
+            std::atomic<bool>            failed;    // Есть не число
+        };
+
+        // Блоки с ячейками формул заранее становятся собственными и
+        // плотными: при записи результатов они не перевыделяются, а участки
+        // диапазонов указывают на сами ячейки формул, даже пустые
+        std::map<FormulaGraph::Key, size_t> position;
+        std::vector<Job>                    jobs(cells.size());
+        std::vector<Cell>                   previous(cells.size());
+        for (size_t f = 0; f < cells.size(); ++f) {
+            const FormulaGraph::Key& cell = cells[f];
+            previous[f] = columns[cell.second].get(cell.first);
+            columns[cell.second].makeDense(cell.first);
+            position[cell]  = f;
+            jobs[f].cell    = cell;
+            jobs[f].formula = formulas.find(cell.first, cell.second);
+            jobs[f].inputs  = 0;
+            jobs[f].failed  = false;
+        }
+        size_t total = 0;
+        for (Job& job : jobs) {
+            for (const FormulaGraph::Key& reader :
+                 formulas.readersOf(job.cell)) {
+                size_t h = position[reader];
+                job.readers.push_back(h);
+                jobs[h].inputs++;
+            }
+            const FormulaGraph::Formula& formula = *job.formula;
+            for (size_t j = formula.colFrom;
+                 formula.rowFrom <= formula.rowTo && j <= formula.colTo;
+                 ++j) {
+                columns[j].forEachSlice(
+                    formula.rowFrom,
+                    formula.rowTo + 1,
+                    [&](const double*    numbers,
+                        const Cell::Tag* tags,
+                        size_t           n) {
+                        job.slices.push_back(Slice{numbers, tags, n});
+                    });
+            }
+            job.partials.resize(job.slices.size());
+            size_t cellsInPiece = 0; // Части - не меньше kPieceCells ячеек
+            for (size_t s = 0; s < job.slices.size(); ++s) {
+                if (cellsInPiece == 0) {
+                    job.pieces.push_back(s);
+                }
+                cellsInPiece += job.slices[s].n;
+                if (cellsInPiece >= kPieceCells) {
+                    cellsInPiece = 0;
+                }
+            }
+            job.pieces.push_back(job.slices.size());
+            job.remaining = job.pieces.size() - 1;
+            total += std::max<size_t>(job.pieces.size() - 1, 1);
+        }
+
+        TaskPool pool(std::min(threads, total));
+        std::function<void(size_t, size_t)> start;
+        std::function<void(size_t, size_t)> finish =
+            [&](size_t f, size_t worker) { // Сборка результата формулы
+                Job&                         job     = jobs[f];
+                const FormulaGraph::Formula& formula = *job.formula;
+                FormulaCell::Accumulator accumulator(formula.op,
+                                                     formula.precision);
+                for (size_t s = 0; s < job.slices.size(); ++s) {
+                    accumulator.addFolded(job.partials[s], job.slices[s].n);
+                }
+                Cell value;
+                if (!job.failed) {
+                    try {
+                        value = Cell(accumulator.result());
+                    } catch (const std::runtime_error&) {
+                        value = Cell();
+                    }
+                }
+                columns[job.cell.second].set(job.cell.first, value);
+                for (size_t h : job.readers) {
+                    if (jobs[h].inputs.fetch_sub(1) == 1) {
+                        start(h, worker);
+                    }
+                }
+            };
+        start = [&](size_t f, size_t worker) { // Запуск частей формулы
+            Job& job = jobs[f];
+            if (job.remaining == 0) {
+                finish(f, worker);
+                return;
+            }
+            for (size_t p = 0; p + 1 < job.pieces.size(); ++p) {
+                pool.submit(worker, [&, f, p](size_t current) {
+                    Job&                     target = jobs[f];
+                    FormulaCell::Accumulator accumulator(
+                        target.formula->op, target.formula->precision);
+                    for (size_t s = target.pieces[p]; s < target.pieces[p + 1];
+                         ++s) {
+                        const Slice& slice = target.slices[s];
+                        for (size_t i = 0; i < slice.n && !target.failed; ++i) {
+                            if (slice.tags[i].type != Cell::NUMBER) {
+                                target.failed = true;
+                            }
+                        }
+                        target.partials[s] =
+                            accumulator.fold(slice.numbers, slice.n);
+                    }
+                    if (target.remaining.fetch_sub(1) == 1) {
+                        finish(f, current);
+                    }
+                });
+            }
+        };
+        for (size_t f = 0, k = 0; f < jobs.size(); ++f) {
+            if (jobs[f].inputs == 0) {
+                size_t worker = k++ % pool.size();
+                pool.submit(worker,
+                            [&, f](size_t current) { start(f, current); });
+            }
+        }
+        pool.run();
+        for (size_t f = 0; f < jobs.size(); ++f) {
+            const FormulaGraph::Key& cell = jobs[f].cell;
+            widths[cell.second]           = kUnknownWidth;
+            indexCell(cell.first,
+                      cell.second,
+                      previous[f],
+                      columns[cell.second].get(cell.first));
+        }
+    }
+
+    void adopt(std::vector<Column>& parsed,
+               size_t               rows,
+               size_t threads = 0) { // Замена содержимого прочитанными
+                                     // столбцами; формулы пересчитываются в
+                                     // threads потоках (0 - по числу ядер)
+        columns.swap(parsed);
+        row    = rows;           // Обновляем количество строк
+        column = columns.size(); // Обновляем количество столбцов
+        widths.assign(column, kUnknownWidth);
+        invalidateCaches();
+        rebuildIndexes();
+        formulas.retain(row, column);
+        recalculateAll(threads);
+    }
+
+    friend class CsvStream;
+
+    Table gather(const std::vector<size_t>& rows,
+                 size_t header) const { // Таблица из первых header строк и
+                                        // строк rows в заданном порядке
+        std::vector<Column> result(column);
+        for (size_t j = 0; j < column; ++j) {
+            for (size_t i = 0; i < header; ++i) {
+                result[j].push(columns[j].get(i));
+            }
+            for (size_t i : rows) {
+                result[j].push(columns[j].get(i));
+            }
+        }
+        Table gathered(0, 0);
+        gathered.adopt(result, header + rows.size());
+        return gathered;
+    }
+
+    static size_t cellWidth(const Cell& cell) { // Ширина ячейки при выводе
+        if (cell.getType() == Cell::EMPTY) {
+            return 4; // "None"
+        }
+        if (cell.getType() == Cell::TEXT) {
+            return cell.textLength();
+        }
+        char buffer[TextWriter::kNumberChars];
+        return TextWriter::number(cell.getNumber(), buffer);
+    }
+
+    size_t scanWidth(size_t col,
+                     size_t rowFrom,
+                     size_t rowEnd) const { // Ширина столбца по строкам
+                                            // [rowFrom, rowEnd)
+        size_t width = 0;
+        size_t i     = rowFrom;
+        columns[col].forEachSlice(
+            rowFrom,
+            rowEnd,
+            [&](const double* numbers, const Cell::Tag* tags, size_t n) {
+                if (tags == Column::emptyTags()) { // Только пустые ячейки
+                    width = std::max<size_t>(width, 4);
+                    i += n;
+                    return;
+                }
+                char buffer[TextWriter::kNumberChars];
+                for (size_t k = 0; k < n; ++k, ++i) {
+                    size_t cell = 4; // Пустая ячейка выводится как "None"
+                    if (tags[k].type == Cell::NUMBER) {
+                        cell = TextWriter::number(numbers[k], buffer);
+                    } else if (tags[k].type == Cell::TEXT) {
+                        cell = columns[col].get(i).textLength();
+                    }
+                    width = std::max(width, cell);
+                }
+            });
+        return width;
+    }
+
+    ColumnIndex& ownIndex(size_t col) { // Собственная копия индекса столбца
+                                        // перед изменением
+        if (indexes[col].use_count() > 1) {
+            indexes[col] = std::make_shared<ColumnIndex>(*indexes[col]);
+        }
+        return *indexes[col];
+    }
+
+    void indexCell(size_t      rows,
+                   size_t      col,
+                   const Cell& before,
+                   const Cell& after) { // Обновление индекса столбца при
+                                        // замене ячейки
+        if (indexes[col] && before != after) {
+            ColumnIndex& index = ownIndex(col);
+            index.erase(rows, before);
+            index.insert(rows, after);
+        }
+        if (rows == 0 && names && before != after) {
+            renameFeature(col, featureName(before), featureName(after));
+        }
+    }
+
+    static std::string featureName(const Cell& cell) { // Название признака
+                                                       // по ячейке заголовка
+        if (cell.getType() == Cell::TEXT) {
+            return cell.getText();
+        } else if (cell.getType() == Cell::NUMBER) {
+            return std::to_string(cell.getNumber());
+        }
+        return "None";
+    }
+
+    void renameFeature(size_t             col,
+                       const std::string& before,
+                       const std::string& after) { // Обновление соответствия
+                                                   // названий столбцам при
+                                                   // переименовании столбца
+                                                   // col (до записи ячейки)
+        std::shared_ptr<std::unordered_map<std::string, size_t> > renamed =
+            std::make_shared<std::unordered_map<std::string, size_t> >(
+                *names);
+        auto found = renamed->find(before);
+        if (found != renamed->end() && found->second == col) {
+            renamed->erase(found); // Название переходит к следующему
+                                   // столбцу с тем же названием
+            for (size_t j = col + 1; j < column; j++) {
+                if (featureName(columns[j].get(0)) == before) {
+                    renamed->emplace(before, j);
+                    break;
+                }
+            }
+        }
+        size_t& first = renamed->emplace(after, col).first->second;
+        first         = std::min(first, col);
+        names         = renamed;
+    }
+
+    void rebuildIndexes() { // Построение индексов заново после замены
+                            // содержимого столбцов
+        indexes.resize(column);
+        for (size_t j = 0; j < column; j++) {
+            if (!indexes[j]) {
+                continue;
+            }
+            std::shared_ptr<ColumnIndex> rebuilt =
+                std::make_shared<ColumnIndex>();
+            for (ColumnIndex::Kind kind : {ColumnIndex::HASH,
+                                           ColumnIndex::ORDERED}) {
+                if (indexes[j]->has(kind)) {
+                    rebuilt->enable(kind, columns[j], row);
+                }
+            }
+            indexes[j] = rebuilt;
+        }
+        names.reset();
+    }
+
+    void storeCell(size_t       rows,
+                   size_t       col,
+                   const Cell& cell) { // Запись ячейки с поддержкой ширины
+                                       // столбца: она растет сразу, а если
+                                       // уменьшилась самая широкая ячейка,
+                                       // пересчитывается при выводе
+        if (indexes[col] || rows == 0) {
+            indexCell(rows, col, columns[col].get(rows), cell);
+        }
+        size_t& width = widths[col];
+        if (width != kUnknownWidth) {
+            size_t added = cellWidth(cell);
+            if (added >= width) {
+                width = added;
+            } else if (cellWidth(columns[col].get(rows)) == width) {
+                width = kUnknownWidth;
+            }
+        }
+        columns[col].set(rows, cell);
+    }
+
+    std::vector<size_t> getLengthFeatures() const {
+        std::vector<size_t>
+            columnWidths( // Метод, возращающий максимальную длину (в смысле
+                          // строки) каждого признака
+                column,
+                0);
+        for (size_t j = 0; j < column; j++) {
+            columnWidths[j] =
+                widths[j] != kUnknownWidth ? widths[j] : scanWidth(j, 0, row);
+        }
+        return columnWidths;
+    }
+
+    void render(std::ostream&              os,
+                size_t                     rowFrom,
+                size_t                     rowEnd,
+                const std::vector<size_t>& columnWidths,
+                bool left) const { // Вывод строк [rowFrom, rowEnd) через
+                                   // буфер; left - выравнивание по левому
+                                   // краю
+        Stats::Scope timer(Stats::RENDER);
+        Stats::add(Stats::RENDER_CALLS);
+        Stats::add(Stats::RENDER_CELLS, (rowEnd - rowFrom) * column);
+        std::string line; // Разделитель строк таблицы
+        for (size_t k = 0; k < column; k++) {
+            line.append(columnWidths[k] + 4, '-');
+        }
+        line.push_back('\n');
+
+        TextWriter writer(os);
+        char       buffer[TextWriter::kNumberChars];
+        writer.put(line);
+        for (size_t i = rowFrom; i < rowEnd; i++) {
+            writer.put("|");
+            for (size_t j = 0; j < column; j++) {
+                const Column& col = columns[j];
+                if (col.getType(i) == Cell::EMPTY) {
+                    writer.put("None", columnWidths[j], left);
+                } else if (col.getType(i) == Cell::TEXT) {
+                    Cell text = col.get(i);
+                    writer.put(text.getTextView(), columnWidths[j], left);
+                } else {
+                    size_t length =
+                        TextWriter::number(col.getNumber(i), buffer);
+                    writer.put(std::string_view(buffer, length),
+                               columnWidths[j],
+                               left);
+                }
+                writer.put(" |  ");
+            }
+            writer.put("\n");
+            writer.put(line);
+        }
+    }
+
+    std::vector<size_t> pageWidths(size_t rowFrom, size_t rowEnd)
+        const { // Ширина столбцов по строкам [rowFrom, rowEnd)
+        std::vector<size_t> columnWidths(column);
+        for (size_t j = 0; j < column; j++) {
+            columnWidths[j] = scanWidth(j, rowFrom, rowEnd);
+        }
+        return columnWidths;
+    }
+
+    size_t pageEnd(size_t rowFrom,
+                   size_t rowTo) const { // Конец страницы [rowFrom, rowTo]
+        if (rowFrom >= row || rowFrom > rowTo) {
+            throw std::out_of_range("Индекс строки вне диапазона.");
+        }
+        return std::min(rowTo, row - 1) + 1;
+    }
+
+    void checkRange(size_t rowFrom,
+                    size_t colFrom,
+                    size_t rowTo,
+                    size_t colTo) const { // Проверка диапазона один раз
+        if (rowFrom <= rowTo && colFrom <= colTo &&
+            (rowTo >= row || colTo >= column)) {
+            throw std::out_of_range("Индекс ячейки вне диапазона.");
+        }
+    }
+
+public:
+    Table()
+        : columns(1, Column(1)),
+          row(1),
+          column(1),
+          indexEnabled(false),
+          indexWithProduct(false),
+          widths(1, 4),
+          indexes(1) {} // Конструктор по-умолчанию
+    Table(size_t rows, size_t cols)
+        : columns(cols, Column(rows)),
+          row(rows),
+          column(cols),
+          indexEnabled(false),
+          indexWithProduct(false),
+          widths(cols, rows > 0 ? 4 : 0),
+          indexes(cols) {} // Конструктор инициализации
+    Table(size_t                                          rows,
+          size_t                                          cols,
+          std::vector<std::vector<std::shared_ptr<Cell> > > cell)
+        : columns(cols, Column(rows)),
+          row(rows),
+          column(cols),
+          indexEnabled(false),
+          indexWithProduct(false),
+          widths(cols, kUnknownWidth),
+          indexes(cols) { // Коснтруктор инициализации всех полей
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                columns[j].set(i, *cell[i][j]);
+            }
+        }
+    }
+    Table(const Table& copyTable)
+        : columns(copyTable.columns),
+          row(copyTable.row),
+          column(copyTable.column),
+          indexEnabled(copyTable.indexEnabled),
+          indexWithProduct(copyTable.indexWithProduct),
+          prefixIndex(copyTable.prefixIndex),
+          summaries(copyTable.summaries),
+          formulas(copyTable.formulas),
+          widths(copyTable.widths),
+          indexes(copyTable.indexes),
+          names(copyTable.names) {} // Конструктор копирования: копия делит
+                                    // блоки столбцов и индексы с
+                                    // оригиналом, пока один из них не
+                                    // изменит блок или индекс
+    std::vector<std::vector<std::shared_ptr<Cell> > > getMatrix()
+        const { // Метод, возвращающий ячейки в виде матрицы объектов Cell
+        std::vector<std::vector<std::shared_ptr<Cell> > > matrix(
+            row, std::vector<std::shared_ptr<Cell> >(column));
+        for (size_t j = 0; j < column; j++) {
+            for (size_t i = 0; i < row; i++) {
+                matrix[i][j] = columns[j].view(i);
+            }
+        }
+        return matrix;
+    }
+
+    std::pair<size_t, size_t> getSize() const {
+        return std::make_pair(row, column);
+    } // Метод, возвращающий пару (кол-во строк, кол-во столбцов)
+
+    static Stats::Snapshot stats() { // Метод, возвращающий снимок счетчиков
+                                     // и задержек операций всех таблиц
+                                     // процесса
+        return Stats::snapshot();
+    }
+
+    void setCell(size_t rows,
+                 size_t col,
+                 double value) { // Метод, устанавливающий числовую ячейку в
+                                 // установленные координаты
+        if (rows >= row || col >= column) {
+            throw std::out_of_range("Индекс ячейки вне диапазона.");
+        }
+        formulas.remove(rows, col);
+        storeCell(rows, col, Cell(value));
+        invalidateCaches();
+        recalculate(formulas.affected(rows, col));
+    }
+
+    void setCell(size_t rows,
+                 size_t col,
+                 const std::string& text) { // Метод, устанавливающий текстовую
+                                            // ячейку в установленные координаты
+        if (rows >= row || col >= column) {
+            throw std::out_of_range("Индекс ячейки вне диапазона.");
+        }
+        formulas.remove(rows, col);
+        storeCell(rows, col, Cell(text));
+        invalidateCaches();
+        recalculate(formulas.affected(rows, col));
+    }
+
+    void setFormula(size_t                 rows,
+                    size_t                 col,
+                    size_t                 rowFrom,
+                    size_t                 colFrom,
+                    size_t                 rowTo,
+                    size_t                 colTo,
+                    FormulaCell::Operation op,
+                    FormulaCell::Precision precision =
+                        FormulaCell::FAST) { // Метод, сохраняющий в ячейке
+                                             // формулу над диапазоном; она
+                                             // пересчитывается при изменении
+                                             // ячеек диапазона
+        if (rows >= row || col >= column) {
+            throw std::out_of_range("Индекс ячейки вне диапазона.");
+        }
+        checkRange(rowFrom, colFrom, rowTo, colTo);
+        FormulaGraph::Formula formula = {
+            rowFrom, colFrom, rowTo, colTo, op, precision};
+        formulas.add(rows, col, formula);
+        recalculate(formulas.order(
+            std::vector<FormulaGraph::Key>(1, FormulaGraph::Key(rows, col))));
+    }
+
+    void recalculateAll(
+        size_t threads = 0) { // Метод, пересчитывающий все формулы в пуле
+                              // из threads потоков (0 - по числу ядер).
+                              // Независимые формулы и части больших
+                              // диапазонов считаются параллельно, а свертки
+                              // частей складываются в том же порядке, что и
+                              // при последовательном расчете, поэтому
+                              // результат совпадает с ним до бита
+        std::vector<FormulaGraph::Key> order = formulas.all();
+        if (order.empty()) {
+            return;
+        }
+        if (threads == 0) {
+            threads = Parallel::hardwareThreads();
+        }
+        if (threads == 1) {
+            recalculate(order);
+            return;
+        }
+        recalculateParallel(order, threads);
+        invalidateCaches();
+    }
+
+    bool isFormula(size_t rows, size_t col)
+        const { // Метод, проверяющий, хранит ли ячейка формулу
+        return formulas.find(rows, col) != nullptr;
+    }
+
+    FormulaCell getFormula(size_t rows, size_t col)
+        const { // Метод, возвращающий формулу ячейки над диапазоном таблицы
+        const FormulaGraph::Formula* formula = formulas.find(rows, col);
+        if (!formula) {
+            throw std::invalid_argument("Ячейка не содержит формулы.");
+        }
+        return FormulaCell(getView(formula->rowFrom,
+                                   formula->colFrom,
+                                   formula->rowTo,
+                                   formula->colTo),
+                           formula->op,
+                           formula->precision);
+    }
+
+    void removeFormula(
+        size_t rows,
+        size_t col) { // Метод, удаляющий формулу; в ячейке остается
+                      // последний результат
+        formulas.remove(rows, col);
+    }
+
+    std::shared_ptr<Cell> getCell(size_t rows, size_t col)
+        const { // Метод, возвращающий ячейку по заданным координатам
+        if (rows >= row || col >= column) {
+            throw std::out_of_range("Индекс ячейки вне диапазона.");
+        }
+        return columns[col].view(rows);
+    }
+
+    Cell getCellValue(size_t rows, size_t col)
+        const { // Метод, возвращающий копию ячейки без выделения памяти
+        if (rows >= row || col >= column) {
+            throw std::out_of_range("Индекс ячейки вне диапазона.");
+        }
+        return columns[col].get(rows);
+    }
+
+    double calculateFormula(
+        size_t rowFrom,
+        size_t colFrom,
+        size_t rowTo,
+        size_t colTo,
+        FormulaCell::Operation op,
+        FormulaCell::Precision precision =
+            FormulaCell::FAST) { // Метод для вычисления операции на
+                                 // заданном диапозоне
+        if (indexEnabled && precision == FormulaCell::FAST) {
+            checkRange(rowFrom, colFrom, rowTo, colTo);
+            buildIndexes();
+        }
+        return static_cast<const Table&>(*this).calculateFormula(
+            rowFrom, colFrom, rowTo, colTo, op, precision);
+    }
+
+    double calculateFormula(
+        size_t                 rowFrom,
+        size_t                 colFrom,
+        size_t                 rowTo,
+        size_t                 colTo,
+        FormulaCell::Operation op,
+        FormulaCell::Precision precision =
+            FormulaCell::FAST) const { // Метод для вычисления операции над
+                                       // неизменяемой таблицей: индекс
+                                       // используется, только если уже
+                                       // построен, поэтому метод можно
+                                       // вызывать из нескольких потоков
+        Stats::Scope timer(
+            static_cast<Stats::Latency>(Stats::FORMULA_SUM + op));
+        Stats::add(Stats::FORMULA_CALLS);
+        if (rowFrom <= rowTo && colFrom <= colTo) {
+            Stats::add(Stats::FORMULA_CELLS,
+                       (rowTo - rowFrom + 1) * (colTo - colFrom + 1));
+        }
+        if (!summaries.empty() && precision == FormulaCell::FAST &&
+            op != FormulaCell::PRODUCT && colFrom == colTo && rowFrom == 0 &&
+            row > 0 && rowTo + 1 == row && colTo < column &&
+            summaries[colTo].numbers == row) { // Весь числовой столбец
+            const ColumnSummary& summary = summaries[colTo];
+            return op == FormulaCell::SUM ? summary.sum : summary.sum / row;
+        }
+        if (prefixIndex && precision == FormulaCell::FAST) {
+            checkRange(rowFrom, colFrom, rowTo, colTo);
+            double result;
+            if (prefixIndex->compute(
+                    rowFrom, colFrom, rowTo, colTo, op, result)) {
+                return result;
+            }
+        }
+        FormulaCell formula(
+            getView(rowFrom, colFrom, rowTo, colTo), op, precision);
+        return formula.compute();
+    }
+
+    double calculateFormula(
+        const std::vector<size_t>& rows,
+        size_t                     colFrom,
+        size_t                     colTo,
+        FormulaCell::Operation     op,
+        FormulaCell::Precision     precision =
+            FormulaCell::FAST) const { // Метод для вычисления операции над
+                                       // отобранными строками (например,
+                                       // методом select) столбцов
+                                       // [colFrom, colTo] без построения
+                                       // промежуточной таблицы
+        Stats::Scope timer(
+            static_cast<Stats::Latency>(Stats::FORMULA_SUM + op));
+        Stats::add(Stats::FORMULA_CALLS);
+        if (colFrom <= colTo) {
+            Stats::add(Stats::FORMULA_CELLS,
+                       rows.size() * (colTo - colFrom + 1));
+        }
+        for (size_t i : rows) {
+            checkRange(i, colFrom, i, colTo);
+        }
+        if (colTo >= column) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+        FormulaCell::Accumulator accumulator(op, precision);
+        double block[256]; // Числа собираются блоками для ядер свёртки
+        for (size_t j = colFrom; j <= colTo; ++j) {
+            size_t filled = 0;
+            for (size_t i : rows) {
+                accumulator.check(columns[j].getType(i));
+                block[filled++] = columns[j].getNumber(i);
+                if (filled == sizeof(block) / sizeof(block[0])) {
+                    accumulator.add(block, filled);
+                    filled = 0;
+                }
+            }
+            accumulator.add(block, filled);
+        }
+        return accumulator.result();
+    }
+
+    RangeView getView(size_t rowFrom,
+                      size_t colFrom,
+                      size_t rowTo,
+                      size_t colTo) const { // Метод, возвращающий диапазон
+                                            // таблицы без копирования ячеек
+        checkRange(rowFrom, colFrom, rowTo, colTo);
+        if (rowFrom > rowTo || colFrom > colTo) {
+            return RangeView();
+        }
+        return RangeView(&columns[colFrom],
+                         rowFrom,
+                         rowTo - rowFrom + 1,
+                         colTo - colFrom + 1);
+    }
+
+    void buildIndexes() { // Метод, заранее строящий включенные индексы и
+                          // соответствие названий признаков столбцам
+        if (!names && row > 0) {
+            std::shared_ptr<std::unordered_map<std::string, size_t> > built =
+                std::make_shared<std::unordered_map<std::string, size_t> >();
+            std::vector<std::string> features = getFeatureNames();
+            for (size_t j = 0; j < features.size(); j++) {
+                built->emplace(features[j], j); // Повтор - первый столбец
+            }
+            names = built;
+        }
+        if (indexEnabled && !prefixIndex) {
+            prefixIndex = std::make_shared<const PrefixIndex>(
+                columns, row, indexWithProduct);
+        }
+    }
+
+    void enablePrefixIndex(
+        bool approximateProduct = false) { // Метод, включающий индекс
+                                           // префиксных сумм для
+                                           // calculateFormula; индекс строится
+                                           // при первом запросе и заново после
+                                           // изменения таблицы. SUM и AVERAGE
+                                           // из индекса точны до последнего
+                                           // знака (иначе диапазон считается
+                                           // напрямую). PRODUCT берется из
+                                           // индекса, только если
+                                           // approximateProduct: он считается
+                                           // через сумму логарифмов и ошибается
+                                           // тем больше, чем больше диапазон
+        if (!indexEnabled || indexWithProduct != approximateProduct) {
+            prefixIndex.reset();
+        }
+        indexEnabled     = true;
+        indexWithProduct = approximateProduct;
+    }
+
+    ColumnSummary getColumnSummary(
+        size_t col) { // Метод, возвращающий сводку по числам столбца; после
+                      // открытия файла она берется из его описания
+        if (col >= column) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+        if (summaries.empty()) {
+            summaries.reserve(column);
+            for (const Column& item : columns) {
+                summaries.push_back(TableFile::summarize(item, row));
+            }
+        }
+        return summaries[col];
+    }
+
+    void disablePrefixIndex() { // Метод, выключающий индекс префиксных сумм
+        indexEnabled = false;
+        prefixIndex.reset();
+    }
+
+    void enableColumnIndex(
+        size_t            col,
+        ColumnIndex::Kind kind) { // Метод, строящий вторичный индекс столбца:
+                                  // HASH - поиск строк по значению, ORDERED -
+                                  // по диапазону чисел; индекс обновляется
+                                  // при каждом изменении столбца
+        if (col >= column) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+        if (!indexes[col]) {
+            indexes[col] = std::make_shared<ColumnIndex>();
+        }
+        if (!indexes[col]->has(kind)) {
+            ownIndex(col).enable(kind, columns[col], row);
+        }
+    }
+
+    void disableColumnIndex(
+        size_t            col,
+        ColumnIndex::Kind kind) { // Метод, удаляющий вторичный индекс столбца
+        if (col >= column) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+        if (indexes[col] && indexes[col]->has(kind)) {
+            ownIndex(col).disable(kind);
+            if (indexes[col]->empty()) {
+                indexes[col].reset();
+            }
+        }
+    }
+
+    std::vector<size_t> findRows(
+        size_t      col,
+        const Cell& value) const { // Метод, возвращающий по возрастанию
+                                   // номера строк, где в столбце col
+                                   // значение value; с хеш-индексом - за
+                                   // O(1), без него - просмотром столбца
+        if (col >= column) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+        if (indexes[col] && indexes[col]->has(ColumnIndex::HASH)) {
+            return indexes[col]->find(value);
+        }
+        std::vector<size_t> rows;
+        for (size_t i = 0; i < row; i++) {
+            if (columns[col].get(i) == value) {
+                rows.push_back(i);
+            }
+        }
+        return rows;
+    }
+
+    std::vector<size_t> findRange(
+        size_t col,
+        double low,
+        double high) const { // Метод, возвращающий по возрастанию номера
+                             // строк с числами из [low, high] в столбце col;
+                             // с упорядоченным индексом - за O(log n) и
+                             // размер ответа, без него - отбором строк
+        if (col >= column) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+        if (indexes[col] && indexes[col]->has(ColumnIndex::ORDERED)) {
+            return indexes[col]->range(low, high);
+        }
+        return select(Predicate::greaterEqual(col, low) &&
+                      Predicate::lessEqual(col, high));
+    }
+
+    size_t findColumn(
+        const std::string& name) { // Метод, возвращающий номер столбца по
+                                   // названию признака (getFeatureNames)
+        buildIndexes();
+        return static_cast<const Table&>(*this).findColumn(name);
+    }
+
+    size_t findColumn(const std::string& name)
+        const { // Метод поиска столбца по названию для неизменяемой
+                // таблицы: соответствие используется, только если уже
+                // построено (buildIndexes)
+        if (names) {
+            auto found = names->find(name);
+            if (found != names->end()) {
+                return found->second;
+            }
+        } else if (row > 0) {
+            std::vector<std::string> features = getFeatureNames();
+            for (size_t j = 0; j < features.size(); j++) {
+                if (features[j] == name) {
+                    return j;
+                }
+            }
+        }
+        throw std::invalid_argument("Признак не найден: " + name);
+    }
+
+    void displayTable() { // Метод, выводящий в красивом формате таблицу
+        for (size_t j = 0; j < column; j++) { // Ширина устаревших столбцов
+            if (widths[j] == kUnknownWidth) {
+                widths[j] = scanWidth(j, 0, row);
+            }
+        }
+        render(std::cout, 0, row, widths, false);
+        std::cout.flush();
+    }
+
+    void displayTable(size_t rowFrom,
+                      size_t rowTo) const { // Метод, выводящий строки
+                                            // [rowFrom, rowTo] с шириной
+                                            // столбцов по этим строкам
+        size_t rowEnd = pageEnd(rowFrom, rowTo);
+        render(std::cout, rowFrom, rowEnd, pageWidths(rowFrom, rowEnd), false);
+        std::cout.flush();
+    }
+
+    std::ostream& printRows(std::ostream& os,
+                            size_t        rowFrom,
+                            size_t        rowTo) const { // Метод, выводящий
+                                                         // строки [rowFrom,
+                                                         // rowTo] в поток, как
+                                                         // оператор <<
+        size_t rowEnd = pageEnd(rowFrom, rowTo);
+        render(os, rowFrom, rowEnd, pageWidths(rowFrom, rowEnd), true);
+        return os;
+    }
+
+    std::vector<std::string> getFeatureNames()
+        const { // Метод возвращающий названия признаков в виде вектор-строки
+        std::vector<std::string> answer;
+        for (size_t i = 0; i < column; i++) {
+            answer.push_back(featureName(columns[i].get(0)));
+        }
+        return answer;
+    }
+
+    void readFromFile(
+        const char delimiter = ',') { // Метод для чтения таблицы из файла
+        std::string filename;
+        std::cout << "Введите относительный/абсолютный путь файла..."
+                  << std::endl;
+        std::getline(std::cin, filename);
+        readFromFile(filename, CsvOptions(delimiter));
+    }
+
+    ReadStats readFromFile(const std::string& filename,
+                           const CsvOptions&  options =
+                               CsvOptions()) { // Метод для чтения таблицы из
+                                               // CSV-файла по заданному пути
+        Stats::Scope timer(Stats::READ);
+        Stats::add(Stats::READ_CALLS);
+        std::chrono::steady_clock::time_point started =
+            std::chrono::steady_clock::now();
+        std::shared_ptr<const MappedFile> file;
+        std::vector<Column>               parsed;
+        ReadStats                         stats = {};
+        size_t                            rows;
+        try {
+            file = std::make_shared<const MappedFile>(filename);
+            rows = options.lazy ? CsvParser::parseLazy(
+                                      file, options, parsed, stats)
+                                : CsvParser::parseParallel(file->data(),
+                                                           file->size(),
+                                                           options,
+                                                           parsed,
+                                                           stats);
+        } catch (...) {
+            Stats::add(Stats::READ_FAILURES);
+            throw;
+        }
+        adopt(parsed, rows, options.threads);
+        Stats::add(Stats::READ_BYTES, file->size());
+        Stats::add(Stats::READ_ROWS, rows);
+        Stats::add(Stats::READ_TEXT_FIELDS, stats.textFields);
+        Stats::add(Stats::READ_PADDED_ROWS, stats.paddedRows);
+
+        stats.bytes   = file->size();
+        stats.seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - started)
+                            .count();
+        return stats;
+    }
+
+    void save(const std::string& filename)
+        const { // Метод для записи таблицы в двоичный файл
+        TableFile::save(filename, columns, row);
+    }
+
+    static Table open(
+        const std::string& filename) { // Метод для открытия двоичного файла
+                                       // таблицы; ячейки читаются прямо из
+                                       // отображенного в память файла и
+                                       // копируются только при изменении
+        Table                      table(0, 0);
+        std::vector<Column>        loaded;
+        std::vector<ColumnSummary> described;
+        size_t rows = TableFile::open(filename, loaded, described);
+        table.adopt(loaded, rows);
+        table.summaries.swap(described);
+        return table;
+    }
+
+    Table operator+(const Table& other)
+        const { // Перегружаем оператор +, возвращает новый объект
+        Stats::Scope timer(Stats::CONCAT);
+        Stats::add(Stats::CONCAT_CALLS);
+        if (row != other.row) {
+            throw std::invalid_argument(
+                "Конкатенация невозможна в силу разного кол-во объектов");
+        }
+        Table newObject(row, 0);
+        newObject.columns.reserve(column + other.column);
+        newObject.columns.insert(
+            newObject.columns.end(), columns.begin(), columns.end());
+        newObject.columns.insert(newObject.columns.end(),
+                                 other.columns.begin(),
+                                 other.columns.end());
+        newObject.column   = column + other.column;
+        newObject.widths   = widths;
+        newObject.widths.insert(
+            newObject.widths.end(), other.widths.begin(), other.widths.end());
+        newObject.formulas = formulas;
+        newObject.formulas.merge(other.formulas, 0, column);
+        newObject.indexes = indexes;
+        newObject.indexes.insert(newObject.indexes.end(),
+                                 other.indexes.begin(),
+                                 other.indexes.end());
+        return newObject;
+    }
+
+    Table& operator+=(
+        const Table& other) { // Перегружаем оператор +=, изменяет объект слева
+        Stats::Scope timer(Stats::CONCAT);
+        Stats::add(Stats::CONCAT_CALLS);
+        if (row != other.row) {
+            throw std::invalid_argument(
+                "Конкатенация невозможна в силу разного кол-во объектов");
+        }
+        if (this == &other) {
+            return *this; // Проверка на самоприсваивание
+        }
+        columns.insert(
+            columns.end(), other.columns.begin(), other.columns.end());
+        formulas.merge(other.formulas, 0, column);
+        widths.insert(widths.end(), other.widths.begin(), other.widths.end());
+        indexes.insert(
+            indexes.end(), other.indexes.begin(), other.indexes.end());
+        column += other.column;
+        invalidateCaches();
+        names.reset();
+        return *this;
+    }
+
+    Table& appendRows(
+        const Table& other) { // Метод, дописывающий строки другой таблицы
+                              // снизу; блоки столбцов присоединяются без
+                              // копирования ячеек
+        Stats::Scope timer(Stats::CONCAT);
+        Stats::add(Stats::CONCAT_CALLS);
+        if (column != other.column) {
+            throw std::invalid_argument(
+                "Объединение невозможно в силу разного кол-ва признаков");
+        }
+        FormulaGraph added = other.formulas;
+        size_t       rows  = other.row;
+        for (size_t j = 0; j < column; j++) {
+            Column linked = other.columns[j];
+            columns[j].append(std::move(linked));
+            if (indexes[j]) { // Новые строки добавляются в индекс
+                ColumnIndex& index = ownIndex(j);
+                for (size_t i = row; i < row + rows; i++) {
+                    index.insert(i, columns[j].get(i));
+                }
+            }
+            if (widths[j] != kUnknownWidth &&
+                other.widths[j] != kUnknownWidth) {
+                widths[j] = std::max(widths[j], other.widths[j]);
+            } else {
+                widths[j] = kUnknownWidth;
+            }
+        }
+        formulas.merge(added, row, 0);
+        if (row == 0) {
+            names.reset();
+        }
+        row += rows;
+        invalidateCaches();
+        return *this;
+    }
+
+    bool operator==(const Table& other) const { // Перегружаем оператор ==;
+                                                // столбцы с одинаковыми
+                                                // границами блоков
+                                                // сравниваются по отпечаткам,
+                                                // остальные - по ячейкам, но
+                                                // с той же семантикой: NaN
+                                                // равен NaN с теми же
+                                                // битами, -0 равен 0
+        if (this->getSize() != other.getSize()) {
+            return false;
+        }
+        for (size_t j = 0; j < column; j++) {
+            const Column& mine   = columns[j];
+            const Column& theirs = other.columns[j];
+            if (mine.sameLayout(theirs)) {
+                for (size_t k = 0; k < mine.chunkCount(); k++) {
+                    if (mine.chunkPrint(k) != theirs.chunkPrint(k)) {
+                        return false;
+                    }
+                }
+                continue;
+            }
+            for (size_t i = 0; i < row; i++) {
+                if (!Column::same(mine.get(i), theirs.get(i))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    Table groupBy(const std::vector<size_t>&      keyColumns,
+                  const std::vector<Aggregation>& aggregations,
+                  const GroupOptions&             options =
+                      GroupOptions()) const { // Метод, группирующий строки по
+                                              // значениям ключевых столбцов;
+                                              // в результате - ключи и
+                                              // агрегаты каждой группы
+        for (size_t key : keyColumns) {
+            if (key >= column) {
+                throw std::out_of_range("Индекс столбца вне диапазона.");
+            }
+        }
+        for (const Aggregation& aggregation : aggregations) {
+            if (aggregation.column >= column) {
+                throw std::out_of_range("Индекс столбца вне диапазона.");
+            }
+        }
+        size_t first = options.header && row > 0 ? 1 : 0;
+        std::vector<Column> result(keyColumns.size() + aggregations.size());
+        if (first) { // Названия признаков результата
+            for (size_t k = 0; k < keyColumns.size(); k++) {
+                result[k].push(columns[keyColumns[k]].get(0));
+            }
+            for (size_t a = 0; a < aggregations.size(); a++) {
+                static const char* const names[] = {
+                    "SUM", "PRODUCT", "AVERAGE"};
+                Cell        title = columns[aggregations[a].column].get(0);
+                std::string name =
+                    title.getType() == Cell::TEXT
+                        ? title.getText()
+                        : std::to_string(aggregations[a].column);
+                result[keyColumns.size() + a].push(Cell(
+                    std::string(names[aggregations[a].op]) + "(" + name + ")"));
+            }
+        }
+        HashAggregator aggregator(columns, keyColumns, aggregations);
+        size_t         groups = aggregator.run(first, row, options, result);
+        Table          grouped(0, 0);
+        grouped.adopt(result, first + groups);
+        return grouped;
+    }
+
+    std::vector<size_t> select(
+        const Predicate& predicate,
+        size_t rowFrom = 0) const { // Метод, возвращающий по возрастанию
+                                    // номера строк начиная с rowFrom,
+                                    // удовлетворяющих условию
+        predicate.check(column);
+        std::vector<size_t>  rows;
+        std::vector<uint8_t> mask(kFilterRows);
+        for (size_t from = rowFrom; from < row; from += kFilterRows) {
+            size_t n = row - from < kFilterRows ? row - from : kFilterRows;
+            predicate.evaluate(columns, from, n, mask.data());
+            for (size_t i = 0; i < n; ++i) {
+                if (mask[i]) {
+                    rows.push_back(from + i);
+                }
+            }
+        }
+        return rows;
+    }
+
+    Table filter(const Predicate& predicate,
+                 size_t rowFrom = 0) const { // Метод, возвращающий таблицу
+                                             // из строк, удовлетворяющих
+                                             // условию; строки до rowFrom
+                                             // (заголовок) сохраняются
+        return gather(select(predicate, rowFrom), std::min(rowFrom, row));
+    }
+
+    std::vector<size_t> sortedRows(
+        const std::vector<SortKey>& keys,
+        const SortOptions&          options =
+            SortOptions()) const { // Метод, возвращающий номера строк в
+                                   // порядке ключей (перестановку строк)
+        for (const SortKey& key : keys) {
+            if (key.column >= column) {
+                throw std::out_of_range("Индекс столбца вне диапазона.");
+            }
+        }
+        size_t first = options.header && row > 0 ? 1 : 0;
+        return RowSorter(columns, first, row, options.threads).sort(keys);
+    }
+
+    Table sortBy(const std::vector<SortKey>& keys,
+                 const SortOptions&          options =
+                     SortOptions()) const { // Метод, возвращающий таблицу,
+                                            // упорядоченную по ключам
+        return gather(sortedRows(keys, options),
+                      options.header && row > 0 ? 1 : 0);
+    }
+
+    std::vector<size_t> topRows(
+        size_t             col,
+        size_t             k,
+        bool               ascending = false,
+        const SortOptions& options   = SortOptions()) const { // Метод,
+                                                              // возвращающий
+                                                              // номера k
+                                                              // первых строк
+                                                              // по столбцу
+        if (col >= column) {
+            throw std::out_of_range("Индекс столбца вне диапазона.");
+        }
+        size_t first = options.header && row > 0 ? 1 : 0;
+        return RowSorter(columns, first, row, options.threads)
+            .top(SortKey{col, ascending}, k);
+    }
+
+    Table topK(size_t             col,
+               size_t             k,
+               bool               ascending = false,
+               const SortOptions& options   = SortOptions())
+        const { // Метод, возвращающий таблицу из k строк с наибольшими
+                // (ascending - с наименьшими) значениями столбца
+        return gather(topRows(col, k, ascending, options),
+                      options.header && row > 0 ? 1 : 0);
+    }
+
+    std::vector<CellRange> diff(
+        const Table& other) const { // Метод, возвращающий диапазоны
+                                    // различающихся ячеек; ячейки
+                                    // проверяются только в блоках с разными
+                                    // отпечатками
+        std::vector<CellRange> changes;
+        size_t                 rows = std::min(row, other.row);
+        size_t                 cols = std::min(column, other.column);
+        for (size_t j = 0; j < cols; j++) {
+            const Column& mine       = columns[j];
+            const Column& theirs     = other.columns[j];
+            auto          compareRows = [&](size_t from, size_t to) {
+                for (size_t i = from; i < to; i++) {
+                    if (Column::same(mine.get(i), theirs.get(i))) {
+                        continue;
+                    }
+                    if (!changes.empty() && changes.back().colFrom == j &&
+                        changes.back().rowTo + 1 == i) {
+                        changes.back().rowTo = i; // Продолжение участка
+                    } else {
+                        changes.push_back(CellRange(i, j, i, j));
+                    }
+                }
+            };
+            if (!mine.sameLayout(theirs)) {
+                compareRows(0, rows);
+                continue;
+            }
+            for (size_t k = 0; k < mine.chunkCount(); k++) {
+                if (mine.chunkPrint(k) != theirs.chunkPrint(k)) {
+                    compareRows(mine.chunkStart(k), mine.chunkStart(k + 1));
+                }
+            }
+        }
+        size_t allRows = std::max(row, other.row);
+        size_t allCols = std::max(column, other.column);
+        if (allCols > cols && rows > 0) { // Лишние столбцы
+            changes.push_back(CellRange(0, cols, rows - 1, allCols - 1));
+        }
+        if (allRows > rows && allCols > 0) { // Лишние строки
+            changes.push_back(CellRange(rows, 0, allRows - 1, allCols - 1));
+        }
+        return changes;
+    }
+
+    std::string identify() const {
+        return "Table";
+    } // Метод для идентификации класса
+
+    friend std::ostream& operator<<(
+        std::ostream& os,
+        const Table&
+            table); // Перегружаем оператор, делаем дружественной функцией
+};
+
+inline std::ostream& operator<<(
+    std::ostream& os,
+    const Table& table) { // Вывод таблицы в консоль посредством оператора <<
+    table.render(os, 0, table.row, table.getLengthFeatures(), true);
+    return os;
+}
+
+// Класс ConcurrentTable - Таблица для одновременной работы многих читателей
+// и писателей (MVCC). Читатель получает неизменяемую версию таблицы без
+// блокировок: он отмечает в свободной ячейке эпоху, в которой начал
+// чтение, и атомарно читает указатель на версию. Если свободных ячеек нет,
+// читатель под короткой блокировкой берет версию со счетчиком ссылок и
+// никого не ждет. Писатель изменяет копию текущей версии (она делит с ней
+// блоки столбцов и формулы) и атомарно публикует ее, а старая версия
+// удаляется, когда ее уже не может читать ни один поток. Записи ячеек,
+// накопившиеся, пока занят другой писатель, публикуются одной версией.
+
+class ConcurrentTable {
+private:
+    static const size_t kReaderSlots = 128; // Кол-во ячеек читателей
+
+    struct alignas(64) Slot {        // Ячейка читателя (на своей линии кэша)
+        std::atomic<uint64_t> epoch; // Эпоха начала чтения (0 - свободна)
+    };
+
+    struct Write {                // Запись ячейки, ждущая публикации
+        size_t             row;   // Строка
+        size_t             col;   // Столбец
+        Cell               value; // Новое значение
+        bool               done;  // Опубликована ли (меняется под writer)
+        std::exception_ptr error; // Исключение записи
+    };
+
+    mutable Slot              slots[kReaderSlots]; // Ячейки читателей
+    std::atomic<uint64_t>     epoch;   // Текущая эпоха
+    std::atomic<const Table*> current; // Опубликованная версия
+    std::mutex                writer;  // Очередь писателей
+    std::vector<std::pair<std::shared_ptr<const Table>, uint64_t> >
+        retired; // Замененные версии и эпоха, с которой их не видно
+    mutable std::mutex           latestLock; // Защита latest
+    std::shared_ptr<const Table> latest;     // Опубликованная версия для
+                                             // читателей без ячейки
+    std::mutex                   queueLock;  // Защита queue
+    std::vector<Write*>          queue;      // Записи, ждущие писателя
+
+    size_t enter() const { // Занятие ячейки читателя; kReaderSlots, если
+                           // все ячейки заняты
+        static thread_local size_t hint =
+            std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t k = 0; k < kReaderSlots; ++k) {
+            size_t   slot     = (hint + k) % kReaderSlots;
+            uint64_t expected = 0;
+            if (slots[slot].epoch.load() == 0 &&
+                slots[slot].epoch.compare_exchange_strong(expected,
+                                                          epoch.load())) {
+                hint = slot;
+                return slot;
+            }
+        }
+        return kReaderSlots;
+    }
+
+    void leave(size_t slot) const { slots[slot].epoch.store(0); }
+
+    void publish(std::shared_ptr<const Table> next) { // Публикация версии
+                                                      // (под writer)
+        std::shared_ptr<const Table> previous;
+        {
+            std::lock_guard<std::mutex> lock(latestLock);
+            previous = latest;
+            latest   = next;
+        }
+        current.store(next.get());
+        retired.emplace_back(previous, epoch.fetch_add(1) + 1);
+
+        uint64_t oldest = UINT64_MAX; // Самая ранняя эпоха читателей
+        for (const Slot& slot : slots) {
+            uint64_t started = slot.epoch.load();
+            if (started != 0) {
+                oldest = std::min(oldest, started);
+            }
+        }
+        std::vector<std::pair<std::shared_ptr<const Table>, uint64_t> >
+            waiting; // Версии, которые еще могут читаться по ячейкам
+        for (auto& version : retired) {
+            if (version.second > oldest) {
+                waiting.push_back(std::move(version));
+            }
+        }
+        retired.swap(waiting);
+    }
+
+    static void apply(Table& table, const Write& write) { // Запись в версию
+        if (write.value.getType() == Cell::NUMBER) {
+            table.setCell(write.row, write.col, write.value.getNumber());
+        } else {
+            table.setCell(write.row, write.col, write.value.getText());
+        }
+    }
+
+    void commit(const std::vector<Write*>& batch) { // Публикация накопленных
+                                                    // записей (под writer)
+        std::shared_ptr<Table> next = std::make_shared<Table>(*current.load());
+        try {
+            for (Write* write : batch) {
+                apply(*next, *write);
+            }
+            publish(next);
+        } catch (...) { // Записи публикуются по одной, чтобы ошибка одной
+                        // не отменила остальные
+            for (Write* write : batch) {
+                try {
+                    next = std::make_shared<Table>(*current.load());
+                    apply(*next, *write);
+                    publish(next);
+                } catch (...) {
+                    write->error = std::current_exception();
+                }
+            }
+        }
+        for (Write* write : batch) {
+            write->done = true;
+        }
+    }
+
+    void write(size_t rows, size_t col, Cell value) { // Запись ячейки
+        Write request = {rows, col, std::move(value), false, nullptr};
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            queue.push_back(&request);
+        }
+        std::lock_guard<std::mutex> guard(writer);
+        if (!request.done) { // Запись еще не опубликовал другой писатель
+            std::vector<Write*> batch;
+            {
+                std::lock_guard<std::mutex> lock(queueLock);
+                batch.swap(queue);
+            }
+            commit(batch);
+        }
+        if (request.error) {
+            std::rethrow_exception(request.error);
+        }
+    }
+
+public:
+    class Snapshot { // Версия таблицы, доступная на время жизни объекта
+    private:
+        const ConcurrentTable*       owner;  // Таблица-владелец
+        size_t                       slot;   // Занятая ячейка читателя
+        const Table*                 table;  // Читаемая версия
+        std::shared_ptr<const Table> pinned; // Версия, взятая без ячейки
+
+        friend class ConcurrentTable;
+
+        Snapshot(const ConcurrentTable* source)
+            : owner(source), slot(source->enter()) {
+            if (slot < kReaderSlots) {
+                table = source->current.load();
+                return;
+            }
+            owner = nullptr; // Ячейку освобождать не нужно
+            {
+                std::lock_guard<std::mutex> lock(source->latestLock);
+                pinned = source->latest;
+            }
+            table = pinned.get();
+        }
+
+    public:
+        Snapshot(Snapshot&& other)
+            : owner(other.owner),
+              slot(other.slot),
+              table(other.table),
+              pinned(std::move(other.pinned)) {
+            other.owner = nullptr;
+        }
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot& operator=(Snapshot&&) = delete;
+
+        ~Snapshot() {
+            if (owner) {
+                owner->leave(slot);
+            }
+        }
+
+        const Table& operator*() const { return *table; }
+        const Table* operator->() const { return table; }
+    };
+
+    explicit ConcurrentTable(const Table& initial = Table())
+        : epoch(1), current(nullptr) {
+        for (Slot& slot : slots) {
+            slot.epoch.store(0);
+        }
+        std::shared_ptr<Table> first = std::make_shared<Table>(initial);
+        first->buildIndexes(); // Дальше индексы обновляются при записи
+        latest = first;
+        current.store(first.get());
+    }
+
+    ConcurrentTable(const ConcurrentTable&) = delete;
+    ConcurrentTable& operator=(const ConcurrentTable&) = delete;
+
+    Snapshot read() const {
+        return Snapshot(this);
+    } // Метод, возвращающий текущую версию для чтения
+
+    Cell getCellValue(size_t rows, size_t col)
+        const { // Метод, возвращающий ячейку текущей версии
+        return read()->getCellValue(rows, col);
+    }
+
+    double calculateFormula(size_t                 rowFrom,
+                            size_t                 colFrom,
+                            size_t                 rowTo,
+                            size_t                 colTo,
+                            FormulaCell::Operation op,
+                            FormulaCell::Precision precision =
+                                FormulaCell::FAST) const { // Метод для
+                                                           // вычисления
+                                                           // операции над
+                                                           // текущей версией
+        return read()->calculateFormula(
+            rowFrom, colFrom, rowTo, colTo, op, precision);
+    }
+
+    template <class Change>
+    void update(Change change) { // Метод, применяющий change к копии
+                                 // текущей версии и публикующий ее; серию
+                                 // изменений выгоднее делать одним вызовом.
+                                 // Индексы столбцов и названий признаков
+                                 // обновляются при записи ячеек, а индекс
+                                 // префиксных сумм, как и в Table,
+                                 // сбрасывается и строится заново вызовом
+                                 // buildIndexes внутри change
+        std::lock_guard<std::mutex> guard(writer);
+        std::shared_ptr<Table> next = std::make_shared<Table>(*current.load());
+        change(*next);
+        publish(next);
+    }
+
+    void setCell(size_t rows,
+                 size_t col,
+                 double value) { // Метод, публикующий версию с новым числом;
+                                 // записи, ждущие занятого писателя,
+                                 // публикуются вместе с ней одной версией
+        write(rows, col, Cell(value));
+    }
+
+    void setCell(size_t             rows,
+                 size_t             col,
+                 const std::string& text) { // Метод, публикующий версию с
+                                            // новым текстом так же, как и
+                                            // число
+        write(rows, col, Cell(text));
+    }
+};
+
+// Класс CsvStream - Потоковое чтение CSV-файла порциями по batchRows строк:
+// в памяти одновременно находится только текущая порция, а длинные строки
+// порции уходят из пула строк вместе с ней, поэтому можно обрабатывать
+// файлы больше оперативной памяти. Операция над диапазоном файла вовсе не
+// строит таблиц: разбираются только числа полей диапазона.
+
+class CsvStream {
+private:
+    std::ifstream      file;       // Читаемый файл
+    CsvOptions         options;    // Параметры разбора
+    size_t             batchRows;  // Кол-во строк в порции
+    std::string        buffer;     // Непрочитанный остаток файла
+    size_t             scanned;    // Сколько байт буфера уже просмотрено
+    CsvParser::Quoting quoting;    // Состояние разбора в конце
+                                   // просмотренного
+    size_t             records;    // Кол-во полных записей в начале буфера
+    size_t             recordsEnd; // Конец последней полной записи в буфере
+    size_t             rowsRead;   // Кол-во строк в уже выданных порциях
+    size_t             lastStart;  // Номер первой строки последней порции
+
+    static const size_t kReadBytes = 1 << 20; // Размер чтения из файла
+
+    class FormulaSink { // Приемник полей для операции над диапазоном
+                        // файла: поля диапазона разбираются как числа и
+                        // сразу учитываются, остальные только пропускаются
+    private:
+        FormulaCell::Accumulator& accumulator; // Результат операции
+        size_t                    rowFrom;     // Первая строка диапазона
+        size_t                    colFrom;     // Первый столбец диапазона
+        size_t                    rowTo;       // Последняя строка диапазона
+        size_t                    colTo;       // Последний столбец
+        size_t                    records;     // Кол-во начатых записей
+        size_t                    columns;     // Кол-во столбцов
+        double                    block[256];  // Числа для ядер свертки
+        size_t                    filled;      // Кол-во чисел в block
+
+        bool inside(size_t j) const { // Лежит ли поле j текущей записи в
+                                      // диапазоне
+            return records > rowFrom && records - 1 <= rowTo &&
+                   j >= colFrom && j <= colTo;
+        }
+
+    public:
+        FormulaSink(FormulaCell::Accumulator& result,
+                    size_t                    firstRow,
+                    size_t                    firstCol,
+                    size_t                    lastRow,
+                    size_t                    lastCol)
+            : accumulator(result),
+              rowFrom(firstRow),
+              colFrom(firstCol),
+              rowTo(lastRow),
+              colTo(lastCol),
+              records(0),
+              columns(lastCol + 1),
+              filled(0) {}
+
+        size_t rows() const { return records; } // Кол-во прочитанных строк
+
+        size_t width() const { return columns; } // Кол-во столбцов
+        void   addColumn(size_t) { ++columns; } // Поле за диапазоном
+        void   field(size_t j, std::string_view value, bool) {
+            if (j == 0) {
+                ++records;
+            }
+            if (!inside(j)) {
+                return;
+            }
+            double number;
+            if (value.empty()) {
+                accumulator.check(Cell::EMPTY);
+            } else if (!CsvParser::parseNumber(value, number)) {
+                accumulator.check(Cell::TEXT);
+            }
+            block[filled++] = number;
+            if (filled == sizeof(block) / sizeof(block[0])) {
+                flush();
+            }
+        } // Очередное поле j-го столбца
+        void skip(size_t j) {
+            if (inside(j)) {
+                accumulator.check(Cell::EMPTY);
+            }
+        } // Недостающее поле j-го столбца
+
+        void flush() { // Учет накопленных чисел
+            accumulator.add(block, filled);
+            filled = 0;
+        }
+    };
+
+    void countRecords(size_t limit) { // Поиск концов записей в буфере, пока
+                                      // их меньше limit
+        const char* data = buffer.data();
+        const char* pos  = data + scanned;
+        if (records < limit) { // Кавычки - по тем же правилам, что и при
+                               // разборе порции
+            quoting = CsvParser::walk(pos,
+                                      data + buffer.size(),
+                                      quoting,
+                                      options,
+                                      [&](const char* next) {
+                                          records++;
+                                          recordsEnd = next - data;
+                                          return records < limit;
+                                      });
+        }
+        scanned = pos - data;
+    }
+
+public:
+    CsvStream(const std::string& filename,
+              const CsvOptions&  csvOptions = CsvOptions(),
+              size_t             rowsPerBatch = 65536) // Открытие файла
+        : file(filename, std::ios::binary),
+          options(csvOptions),
+          batchRows(std::max<size_t>(1, rowsPerBatch)),
+          scanned(0),
+          quoting(CsvParser::FIELD_START),
+          records(0),
+          recordsEnd(0),
+          rowsRead(0),
+          lastStart(0) {
+        if (!file.is_open()) {
+            throw std::runtime_error("Не удалось открыть файл: " + filename);
+        }
+    }
+
+    size_t fill() { // Дочитывание файла до batchRows полных записей;
+                    // возвращает размер порции в начале буфера (0 - файл
+                    // закончился)
+        countRecords(batchRows);
+        while (records < batchRows && file) { // Дочитываем файл
+            size_t size = buffer.size();
+            buffer.resize(size + kReadBytes);
+            file.read(&buffer[size], kReadBytes);
+            buffer.resize(size + static_cast<size_t>(file.gcount()));
+            countRecords(batchRows);
+        }
+        return records < batchRows ? buffer.size() : recordsEnd;
+    }
+
+    void consume(size_t cut) { // Удаление порции из буфера
+        buffer.erase(0, cut); // Разрез всегда на границе записей
+        scanned    = 0;
+        quoting    = CsvParser::FIELD_START;
+        records    = 0;
+        recordsEnd = 0;
+    }
+
+    bool next(Table& batch) { // Чтение следующей порции строк в batch;
+                              // false, если файл закончился. Строки
+                              // прежней порции освобождаются с ней
+        size_t cut = fill();
+        if (cut == 0) {
+            return false;
+        }
+        std::vector<Column> parsed;
+        size_t rows = CsvParser::parse(buffer.data(), cut, options, parsed);
+        consume(cut);
+        batch.adopt(parsed, rows);
+        lastStart = rowsRead;
+        rowsRead += rows;
+        return true;
+    }
+
+    size_t batchStart() const {
+        return lastStart;
+    } // Номер первой строки последней порции в файле
+
+    static double calculateFormula(
+        const std::string&     filename,
+        const CsvOptions&      csvOptions,
+        size_t                 rowFrom,
+        size_t                 colFrom,
+        size_t                 rowTo,
+        size_t                 colTo,
+        FormulaCell::Operation op,
+        FormulaCell::Precision precision    = FormulaCell::FAST,
+        size_t                 rowsPerBatch = 65536) { // Вычисление операции
+                                                       // на диапазоне файла
+                                                       // без загрузки его
+                                                       // целиком
+        FormulaCell::Accumulator accumulator(op, precision);
+        if (rowFrom <= rowTo && colFrom <= colTo) {
+            CsvStream   stream(filename, csvOptions, rowsPerBatch);
+            FormulaSink sink(accumulator, rowFrom, colFrom, rowTo, colTo);
+            while (sink.rows() <= rowTo) { // Поля ищутся так же, как при
+                                           // разборе порции в таблицу
+                size_t cut = stream.fill();
+                if (cut == 0) {
+                    break;
+                }
+                CsvParser::scan(
+                    stream.buffer.data(), cut, stream.options, sink);
+                stream.consume(cut);
+            }
+            if (sink.rows() <= rowTo) {
+                throw std::out_of_range("Индекс ячейки вне диапазона.");
+            }
+            sink.flush();
+        }
+        return accumulator.result();
+    }
+};
+
+#endif // TABLE_H_
@@ -0,0 +1,376 @@
+// Нагрузочные замеры таблицы на синтетических данных. Каждая операция
+// выполняется несколько раз, а результаты (минимальное и медианное время,
+// ячеек в секунду) печатаются в JSON, чтобы сравнивать их между выпусками.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "table.h"
+
+// Структура BenchOptions - Параметры запуска: размер таблицы, доли текстовых
+// и пустых ячеек, кол-во повторов и пути файлов.
+
+struct BenchOptions {
+    size_t      rows;   // Кол-во строк таблицы
+    size_t      cols;   // Кол-во столбцов таблицы
+    double      text;   // Доля текстовых ячеек
+    double      empty;  // Доля пустых ячеек
+    size_t      repeat; // Кол-во повторов каждого замера
+    uint64_t    seed;   // Зерно генератора данных
+    std::string output; // Файл результатов (пусто - стандартный вывод)
+    std::string csv;    // Временный CSV-файл для замера чтения
+
+    BenchOptions()
+        : rows(100000),
+          cols(8),
+          text(0.3),
+          empty(0.1),
+          repeat(5),
+          seed(42),
+          csv("table_bench.csv") {}
+};
+
+// Класс DataGenerator - Генератор синтетических ячеек. Значение ячейки
+// зависит только от зерна и ее координат, поэтому таблица и CSV-файл,
+// построенные одним генератором, совпадают. Половина текстов короткие
+// (хранятся в ячейке), половина длинные (попадают в пул строк).
+
+class DataGenerator {
+private:
+    BenchOptions options; // Параметры данных
+
+    uint64_t draw(size_t rows, size_t col) const { // Случайное число ячейки
+        return Cell::mix(options.seed ^
+                         Cell::mix(rows * options.cols + col));
+    }
+
+public:
+    explicit DataGenerator(const BenchOptions& benchOptions)
+        : options(benchOptions) {}
+
+    Cell cell(size_t rows, size_t col) const { // Ячейка по координатам
+        uint64_t random  = draw(rows, col);
+        double   uniform = (random >> 11) * (1.0 / 9007199254740992.0);
+        if (uniform < options.empty) {
+            return Cell();
+        }
+        if (uniform < options.empty + options.text) {
+            size_t word = (random >> 20) % 1000;
+            return Cell((word % 2 == 0 ? "city_" : "description_of_item_") +
+                        std::to_string(word));
+        }
+        int64_t cents = static_cast<int64_t>(random % 2000000) - 1000000;
+        return Cell(cents / 100.0); // Точно совпадает с числом в CSV
+    }
+
+    Table table() const { // Таблица, заполненная через setCell
+        Table table(options.rows, options.cols);
+        for (size_t i = 0; i < options.rows; i++) {
+            for (size_t j = 0; j < options.cols; j++) {
+                Cell value = cell(i, j);
+                if (value.getType() == Cell::NUMBER) {
+                    table.setCell(i, j, value.getNumber());
+                } else if (value.getType() == Cell::TEXT) {
+                    table.setCell(i, j, value.getText());
+                }
+            }
+        }
+        return table;
+    }
+
+    size_t writeCsv(const std::string& filename)
+        const { // Запись тех же данных в CSV-файл; возвращает его размер
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Не удалось создать файл " + filename);
+        }
+        std::string line;
+        size_t      bytes = 0;
+        char        number[32];
+        for (size_t i = 0; i < options.rows; i++) {
+            line.clear();
+            for (size_t j = 0; j < options.cols; j++) {
+                if (j > 0) {
+                    line += ',';
+                }
+                Cell value = cell(i, j);
+                if (value.getType() == Cell::NUMBER) {
+                    std::snprintf(
+                        number, sizeof(number), "%.2f", value.getNumber());
+                    line += number;
+                } else if (value.getType() == Cell::TEXT) {
+                    line += value.getText();
+                }
+            }
+            line += '\n';
+            file << line;
+            bytes += line.size();
+        }
+        return bytes;
+    }
+};
+
+// Класс NullBuffer - Буфер потока, отбрасывающий данные: замер вывода
+// не зависит от скорости консоли или диска.
+
+class NullBuffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        return count;
+    }
+    int overflow(int symbol) override { return symbol; }
+};
+
+// Структура Measurement - Итог замера одной операции.
+
+struct Measurement {
+    std::string name;       // Название замера
+    size_t      items;      // Кол-во обработанных ячеек за прогон
+    size_t      iterations; // Кол-во прогонов
+    double      minimum;    // Минимальное время прогона, с
+    double      median;     // Медианное время прогона, с
+    double      mean;       // Среднее время прогона, с
+};
+
+// Класс Benchmark - Запуск замеров и вывод их результатов в JSON.
+
+class Benchmark {
+private:
+    BenchOptions             options; // Параметры запуска
+    std::vector<Measurement> results; // Итоги замеров
+    double                   sink;    // Результаты операций (против
+                                      // удаления кода оптимизатором)
+
+public:
+    explicit Benchmark(const BenchOptions& benchOptions)
+        : options(benchOptions), sink(0) {}
+
+    template <class Task>
+    void measure(const std::string& name,
+                 size_t             items,
+                 Task               task) { // Метод, выполняющий task
+                                            // repeat раз и сохраняющий время
+        std::vector<double> times;
+        for (size_t k = 0; k < options.repeat; k++) {
+            std::chrono::steady_clock::time_point started =
+                std::chrono::steady_clock::now();
+            sink += task();
+            times.push_back(std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - started)
+                                .count());
+        }
+        std::sort(times.begin(), times.end());
+        double total = 0;
+        for (double time : times) {
+            total += time;
+        }
+        Measurement result = {name,
+                              items,
+                              times.size(),
+                              times.front(),
+                              times[times.size() / 2],
+                              total / times.size()};
+        results.push_back(result);
+        std::cerr << name << ": " << result.median << " с" << std::endl;
+    }
+
+    void write(std::ostream& os) const { // Метод, печатающий итоги в JSON
+        os << "{\n"
+           << "  \"benchmark\": \"table_bench\",\n"
+           << "  \"rows\": " << options.rows << ",\n"
+           << "  \"cols\": " << options.cols << ",\n"
+           << "  \"text\": " << options.text << ",\n"
+           << "  \"empty\": " << options.empty << ",\n"
+           << "  \"repeat\": " << options.repeat << ",\n"
+           << "  \"seed\": " << options.seed << ",\n"
+           << "  \"threads\": " << Parallel::hardwareThreads() << ",\n"
+           << "  \"results\": [";
+        for (size_t k = 0; k < results.size(); k++) {
+            const Measurement& result = results[k];
+            double rate = result.median > 0 ? result.items / result.median : 0;
+            os << (k > 0 ? "," : "") << "\n    {\"name\": \"" << result.name
+               << "\", \"items\": " << result.items
+               << ", \"iterations\": " << result.iterations
+               << ", \"min_seconds\": " << result.minimum
+               << ", \"median_seconds\": " << result.median
+               << ", \"mean_seconds\": " << result.mean
+               << ", \"items_per_second\": " << rate << "}";
+        }
+        os << "\n  ]\n}" << std::endl;
+    }
+
+    void run() { // Метод, выполняющий все замеры
+        DataGenerator generator(options);
+        size_t        cells = options.rows * options.cols;
+
+        measure("setCell", cells, [&]() {
+            return static_cast<double>(generator.table().getSize().first);
+        });
+
+        Table table = generator.table();
+        Table same  = generator.table();
+
+        measure("getCell", cells, [&]() {
+            double types = 0;
+            for (size_t i = 0; i < options.rows; i++) {
+                for (size_t j = 0; j < options.cols; j++) {
+                    types += table.getCell(i, j)->getType();
+                }
+            }
+            return types;
+        });
+        measure("getCellValue", cells, [&]() {
+            double types = 0;
+            for (size_t i = 0; i < options.rows; i++) {
+                for (size_t j = 0; j < options.cols; j++) {
+                    types += table.getCellValue(i, j).getType();
+                }
+            }
+            return types;
+        });
+
+        BenchOptions numericOptions = options; // Формулы требуют диапазона
+        numericOptions.text         = 0;       // из одних чисел
+        numericOptions.empty        = 0;
+        Table numbers = DataGenerator(numericOptions).table();
+
+        const char* operations[] = {"SUM", "PRODUCT", "AVERAGE"};
+        const char* precisions[] = {"FAST", "COMPENSATED"};
+        for (int op = FormulaCell::SUM; op <= FormulaCell::AVERAGE; op++) {
+            for (int precision = FormulaCell::FAST;
+                 precision <= FormulaCell::COMPENSATED;
+                 precision++) {
+                std::string name = std::string("calculateFormula/") +
+                                   operations[op] + "/" +
+                                   precisions[precision];
+                measure(name, cells, [&]() {
+                    return numbers.calculateFormula(
+                        0,
+                        0,
+                        options.rows - 1,
+                        options.cols - 1,
+                        static_cast<FormulaCell::Operation>(op),
+                        static_cast<FormulaCell::Precision>(precision));
+                });
+            }
+        }
+
+        measure("operator<<", cells, [&]() {
+            NullBuffer   buffer;
+            std::ostream discard(&buffer);
+            discard << table;
+            return 0.0;
+        });
+        measure("operator+", cells * 2, [&]() {
+            return static_cast<double>((table + same).getSize().second);
+        });
+        measure("operator+=", cells * 2, [&]() {
+            Table joined(table);
+            joined += same;
+            return static_cast<double>(joined.getSize().second);
+        });
+        measure("operator==", cells, [&]() {
+            if (!(table == same)) {
+                throw std::logic_error("Одинаковые таблицы не равны.");
+            }
+            return 1.0;
+        });
+
+        generator.writeCsv(options.csv);
+        Table loaded;
+        measure("readFromFile", cells, [&]() {
+            loaded.readFromFile(options.csv, CsvOptions(','));
+            return static_cast<double>(loaded.getSize().first);
+        });
+        Table lazy;
+        measure("readFromFile/lazy", cells, [&]() {
+            lazy.readFromFile(options.csv, CsvOptions(',', '"', 0, true));
+            return static_cast<double>(lazy.getSize().first);
+        });
+        measure("readFromFile/lazy/oneColumn", cells, [&]() {
+            Table touched; // Чтение и обращение к одному столбцу
+            touched.readFromFile(options.csv, CsvOptions(',', '"', 0, true));
+            return static_cast<double>(touched.getCellValue(0, 0).getType());
+        });
+        std::remove(options.csv.c_str());
+        if (!(loaded == table) || !(lazy == table)) {
+            throw std::logic_error("Прочитанная таблица не совпадает с "
+                                   "сгенерированной.");
+        }
+    }
+};
+
+BenchOptions parseOptions(int argc, char** argv) { // Разбор аргументов
+    BenchOptions options;
+    for (int k = 1; k < argc; k++) {
+        std::string key = argv[k];
+        if (k + 1 >= argc) {
+            throw std::invalid_argument("Не задано значение для " + key);
+        }
+        std::string value = argv[++k];
+        if (key == "--rows") {
+            options.rows = std::stoull(value);
+        } else if (key == "--cols") {
+            options.cols = std::stoull(value);
+        } else if (key == "--text") {
+            options.text = std::stod(value);
+        } else if (key == "--empty") {
+            options.empty = std::stod(value);
+        } else if (key == "--repeat") {
+            options.repeat = std::stoull(value);
+        } else if (key == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (key == "--output") {
+            options.output = value;
+        } else if (key == "--csv") {
+            options.csv = value;
+        } else {
+            throw std::invalid_argument("Неизвестный параметр " + key);
+        }
+    }
+    if (options.rows == 0 || options.cols == 0 || options.repeat == 0) {
+        throw std::invalid_argument(
+            "Кол-во строк, столбцов и повторов должно быть больше нуля.");
+    }
+    if (options.text < 0 || options.empty < 0 ||
+        options.text + options.empty > 1) {
+        throw std::invalid_argument(
+            "Доли текстовых и пустых ячеек должны быть в пределах [0, 1].");
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    try {
+        BenchOptions options = parseOptions(argc, argv);
+        Benchmark    benchmark(options);
+        benchmark.run();
+        if (options.output.empty()) {
+            benchmark.write(std::cout);
+        } else {
+            std::ofstream file(options.output);
+            if (!file) {
+                throw std::runtime_error("Не удалось создать файл " +
+                                         options.output);
+            }
+            benchmark.write(file);
+        }
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        std::cerr << "Параметры: --rows N --cols N --text P --empty P "
+                     "--repeat N --seed N --output FILE --csv FILE"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
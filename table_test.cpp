@@ -0,0 +1,1206 @@
+#undef NDEBUG // Проверки работают и в сборке Release
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "table.h"
+
+void testCell(); // Функция тестирования класса Cell
+void testFormulaCell(); // Функция тестирования класса FormulaCell
+void testTable(); // Функция тестирования класса Table
+
+int main() {
+    testCell();
+    std::cout << "\n\n" << std::endl;
+    testFormulaCell();
+    std::cout << "\n\n" << std::endl;
+    testTable();
+    return 0;
+}
+
+void testCell() {
+    std::cout << "Тестирование Класса Cell..." << std::endl;
+    std::cout << "Тест конструктора по-умолчанию..." << std::endl;
+    Cell cellFirst;
+    assert(cellFirst.getType() == Cell::EMPTY);
+
+    std::cout << "Тест конструктора инициализации..." << std::endl;
+    Cell cellSecond("Hello, world!"), cellSecondDop(400.12);
+    assert(cellSecond.getType() == Cell::TEXT);
+    assert(cellSecond.getText() == "Hello, world!");
+    assert(cellSecondDop.getType() == Cell::NUMBER);
+    assert(cellSecondDop.getNumber() == 400.12);
+
+    std::cout << "Тест конструктора копирования..." << std::endl;
+    Cell cellSecondCopy = cellSecond;
+    assert(cellSecondCopy.getType() == cellSecond.getType());
+    assert(cellSecondCopy.getText() == cellSecond.getText());
+
+    std::cout << "Тест метода setText()..." << std::endl;
+    cellSecondDop.setText("uga-buga");
+    assert(cellSecondDop.getType() == Cell::TEXT);
+    assert(cellSecondDop.getText() == "uga-buga");
+
+    std::cout << "Тест метода setNumber()..." << std::endl;
+    cellSecondDop.setNumber(123.1);
+    assert(cellSecondDop.getType() == Cell::NUMBER);
+    assert(cellSecondDop.getNumber() == 123.1);
+
+    std::cout << "Тест длинного текста..." << std::endl;
+    std::string longText = "Очень длинная строка, не влезающая в ячейку";
+    Cell        cellLong(longText), cellLongSame(longText);
+    assert(sizeof(Cell) == 16);
+    assert(cellLong.getText() == longText);
+    assert(cellLong.textLength() == longText.length());
+    assert(cellLong == cellLongSame);
+    assert(cellLong != cellSecond);
+    assert(cellLong.getTextView() == longText);
+    assert(cellSecond.getTextView() == "Hello, world!");
+    assert(cellLong.hash() == cellLongSame.hash());
+
+    std::cout << "Тест словаря длинных строк из нескольких потоков..."
+              << std::endl;
+    size_t pooled = StringPool::instance().size();
+    std::vector<std::thread>                            writers;
+    std::vector<std::vector<const StringPool::Entry*> > interned(4);
+    for (size_t t = 0; t < interned.size(); t++) {
+        writers.emplace_back([t, &interned]() {
+            StringPool::Cache cache;
+            for (int k = 0; k < 3000; k++) {
+                std::string text = "category number " + std::to_string(k);
+                const StringPool::Entry* entry = cache.intern(text);
+                assert(entry->str() == text);
+                interned[t].push_back(entry);
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    for (size_t t = 1; t < interned.size(); t++) {
+        assert(interned[t] == interned[0]);
+    }
+    assert(StringPool::instance().size() == pooled + 3000);
+    for (std::vector<const StringPool::Entry*>& entries : interned) {
+        for (const StringPool::Entry* entry : entries) {
+            StringPool::instance().release(entry);
+        }
+    }
+    assert(StringPool::instance().size() == pooled);
+
+    std::cout << "Тест освобождения строк пула вместе с ячейками..."
+              << std::endl;
+    {
+        std::string text = "строка таблицы номер ";
+        Cell        first("освобождаемая длинная строка");
+        Cell        copy = first;
+        Cell        moved(std::move(copy));
+        Table       owner(3, 2);
+        for (size_t i = 0; i < 3; i++) {
+            owner.setCell(i, 0, text + std::to_string(i));
+            owner.setCell(i, 1, first.getText());
+        }
+        Table snapshot = owner;
+        owner.setCell(0, 0, 1.0);
+        assert(StringPool::instance().size() == pooled + 4);
+        assert(moved == first);
+        assert(snapshot.getCellValue(0, 0) == Cell(text + "0"));
+    }
+    assert(StringPool::instance().size() == pooled);
+
+    std::cout << "Тест метода clearCell()..." << std::endl;
+    cellSecondDop.clearCell();
+    assert(cellSecondDop.getType() == Cell::EMPTY);
+
+    std::cout << "Тест метода идентификации класса..." << std::endl;
+    assert(cellSecondDop.identify() == "Cell");
+
+    std::cout << "Все тесты пройдены успешно!" << std::endl;
+}
+
+void testFormulaCell() {
+    std::cout << "Тестирование Класса FormulaCell..." << std::endl;
+
+    std::cout << "Тест конструктора по-умолчанию..." << std::endl;
+    FormulaCell formulaFirst;
+    assert(formulaFirst.getType() == Cell::EMPTY);
+    assert(formulaFirst.getOperation() == FormulaCell::SUM);
+
+    std::cout << "Тест конструктора инициализации..." << std::endl;
+    std::vector<Cell> cells;
+    cells.push_back(Cell(2.0));
+    cells.push_back(Cell(2.0));
+    cells.push_back(Cell(3.0));
+
+    FormulaCell formulaSecond(cells, FormulaCell::SUM);
+    assert(formulaSecond.getType() == Cell::NUMBER);
+    assert(formulaSecond.getOperation() == FormulaCell::SUM);
+    assert(formulaSecond.getRange() == cells);
+
+    std::cout << "Тест конструктора копирования..." << std::endl;
+    FormulaCell formulaSecondCopy = formulaSecond;
+    assert(formulaSecond.getType() == formulaSecondCopy.getType());
+    assert(formulaSecond.getOperation() == formulaSecondCopy.getOperation());
+    assert(formulaSecond.getRange() == formulaSecondCopy.getRange());
+
+    std::cout << "Тест метода подсчета операции..." << std::endl;
+    assert(formulaSecondCopy.compute() == 7.0);
+
+    std::cout << "Тест метода смены оператора..." << std::endl;
+    formulaSecondCopy.changeOperation(FormulaCell::PRODUCT);
+    assert(formulaSecondCopy.getOperation() == FormulaCell::PRODUCT);
+    assert(formulaSecondCopy.compute() == 12.0);
+
+    std::cout << "Тест суммирования с компенсацией..." << std::endl;
+    std::vector<Cell> values(1, Cell(1e16));
+    for (int i = 0; i < 1000; i++) {
+        values.push_back(Cell(1.0));
+    }
+    values.push_back(Cell(-1e16));
+    FormulaCell formulaPrecise(values, FormulaCell::SUM);
+    formulaPrecise.changePrecision(FormulaCell::COMPENSATED);
+    assert(formulaPrecise.getPrecision() == FormulaCell::COMPENSATED);
+    assert(formulaPrecise.compute() == 1000.0);
+
+    std::cout << "Тест метода идентификации класса..." << std::endl;
+    assert(formulaSecondCopy.identify() == "FormulaCell");
+
+    std::cout << "Все тесты пройдены успешно!" << std::endl;
+}
+
+void testTable() {
+    std::cout << "Тестирование класса Table..." << std::endl;
+    std::cout << "Тестирование конструктора по-умолчанию..." << std::endl;
+    Table firstTable;
+    assert(firstTable.getSize() ==
+           std::make_pair(static_cast<size_t>(1), static_cast<size_t>(1)));
+
+    std::cout << "Тестирование конструктора инициализации..." << std::endl;
+    Table secondTable(2, 2);
+    assert(secondTable.getSize() ==
+           std::make_pair(static_cast<size_t>(2), static_cast<size_t>(2)));
+
+    std::cout << "Тестирование конструктора копирования..." << std::endl;
+    Table copySecondTable = secondTable;
+    assert(secondTable == copySecondTable);
+    assert(copySecondTable.getMatrix().size() == 2);
+    Table version(200000, 2);
+    version.setCell(0, 0, 1.0);
+    version.setCell(199999, 1, "last");
+    Table snapshot = version;
+    version.setCell(0, 0, 2.0);
+    version.setCell(100000, 1, "changed");
+    assert(snapshot.getCellValue(0, 0).getNumber() == 1);
+    assert(snapshot.getCellValue(100000, 1).getType() == Cell::EMPTY);
+    assert(snapshot.getCellValue(199999, 1).getText() == "last");
+    assert(version.getCellValue(0, 0).getNumber() == 2);
+    assert(version.getCellValue(100000, 1).getText() == "changed");
+
+    std::cout << "Тестирование перегруженной функции setCell и getCell..."
+              << std::endl;
+    Table table(2, 2);
+    table.setCell(0, 0, 1.5);
+    table.setCell(0, 1, "A");
+    table.setCell(1, 0, 2.5);
+    table.setCell(1, 1, "B");
+    assert(table.getCell(0, 0)->getNumber() == 1.5);
+    assert(table.getCell(1, 1)->getText() == "B");
+
+    std::cout << "Тестирование метода calculateFormula..." << std::endl;
+    Table tableLast(3, 2);
+    tableLast.setCell(0, 0, "A");
+    tableLast.setCell(0, 1, "B");
+    tableLast.setCell(1, 0, 2.5);
+    tableLast.setCell(1, 1, 3.5);
+    tableLast.setCell(2, 0, 15);
+    tableLast.setCell(2, 1, 10);
+    assert(tableLast.calculateFormula(1, 0, 2, 1, FormulaCell::SUM) == 31);
+    assert(tableLast.calculateFormula(1, 0, 2, 1, FormulaCell::PRODUCT) ==
+           2.5 * 3.5 * 15 * 10);
+
+    std::cout << "Тестирование метода getView..." << std::endl;
+    RangeView view = tableLast.getView(1, 0, 2, 1);
+    assert(view.rows() == 2 && view.columns() == 2);
+    assert(view.get(1, 0).getNumber() == 15);
+    assert(view.get(0, 1).getNumber() == 3.5);
+    FormulaCell formulaView(view, FormulaCell::AVERAGE);
+    assert(formulaView.compute() == 31.0 / 4);
+    assert(formulaView.getRange().size() == 4);
+    assert(formulaView.getRange()[1].getNumber() == 3.5);
+    assert(tableLast.getView(2, 1, 1, 1).empty());
+
+    std::cout << "Тестирование индекса префиксных сумм..." << std::endl;
+    Table indexed = tableLast;
+    indexed.enablePrefixIndex(true);
+    assert(indexed.calculateFormula(1, 0, 2, 1, FormulaCell::SUM) == 31);
+    assert(indexed.calculateFormula(2, 0, 2, 1, FormulaCell::AVERAGE) == 12.5);
+    double product = indexed.calculateFormula(1, 0, 2, 1, FormulaCell::PRODUCT);
+    assert(std::fabs(product - 2.5 * 3.5 * 15 * 10) < 1e-9);
+    indexed.setCell(2, 1, -4);
+    assert(indexed.calculateFormula(1, 1, 2, 1, FormulaCell::SUM) == -0.5);
+    assert(indexed.calculateFormula(1, 1, 2, 1, FormulaCell::PRODUCT) < 0);
+    bool typeError = false;
+    try {
+        indexed.calculateFormula(0, 0, 2, 1, FormulaCell::SUM);
+    } catch (const std::runtime_error&) {
+        typeError = true;
+    }
+    assert(typeError);
+    Table skewed(1000, 1); // Большое число в начале столбца: разность
+                           // префиксов теряет все знаки малого диапазона
+    skewed.setCell(0, 0, 1e20);
+    for (size_t i = 1; i < 1000; i++) {
+        skewed.setCell(i, 0, i * 0.1);
+    }
+    double skewedSum =
+        skewed.calculateFormula(900, 0, 909, 0, FormulaCell::SUM);
+    double skewedProduct =
+        skewed.calculateFormula(900, 0, 909, 0, FormulaCell::PRODUCT);
+    skewed.enablePrefixIndex();
+    assert(skewed.calculateFormula(900, 0, 909, 0, FormulaCell::SUM) ==
+           skewedSum);
+    assert(skewed.calculateFormula(900, 0, 909, 0, FormulaCell::AVERAGE) ==
+           skewedSum / 10);
+    assert(skewed.calculateFormula(900, 0, 909, 0, FormulaCell::PRODUCT) ==
+           skewedProduct); // Без явного согласия PRODUCT считается напрямую
+    skewed.setCell(0, 0, 1.0);
+    double tailSum = skewed.calculateFormula(1, 0, 999, 0, FormulaCell::SUM);
+    assert(std::fabs(tailSum - 49950) < 1e-9);
+
+    std::cout << "Тестирование формул в ячейках таблицы..." << std::endl;
+    Table sheet(4, 3);
+    for (size_t i = 0; i < 3; i++) {
+        sheet.setCell(i, 0, static_cast<double>(i + 1));
+    }
+    sheet.setFormula(3, 0, 0, 0, 2, 0, FormulaCell::SUM);
+    sheet.setFormula(0, 1, 0, 0, 3, 0, FormulaCell::AVERAGE);
+    sheet.setFormula(1, 1, 0, 1, 0, 1, FormulaCell::PRODUCT);
+    assert(sheet.isFormula(3, 0) && !sheet.isFormula(2, 0));
+    assert(sheet.getCellValue(3, 0).getNumber() == 6);
+    assert(sheet.getCellValue(0, 1).getNumber() == 3);
+    sheet.setCell(2, 0, 7);
+    assert(sheet.getCellValue(3, 0).getNumber() == 10);
+    assert(sheet.getCellValue(1, 1).getNumber() == 5);
+    assert(sheet.getFormula(3, 0).compute() == 10);
+    bool cycleError = false;
+    try {
+        sheet.setFormula(2, 0, 1, 1, 1, 1, FormulaCell::SUM);
+    } catch (const std::invalid_argument&) {
+        cycleError = true;
+    }
+    assert(cycleError && !sheet.isFormula(2, 0));
+    sheet.setCell(1, 0, "text");
+    assert(sheet.getCellValue(3, 0).getType() == Cell::EMPTY);
+    assert(sheet.getCellValue(1, 1).getType() == Cell::EMPTY);
+    sheet.setCell(3, 0, 4);
+    assert(!sheet.isFormula(3, 0));
+    assert(sheet.getCellValue(0, 1).getType() == Cell::EMPTY);
+
+    std::cout << "Тестирование параллельного пересчета формул..." << std::endl;
+    Table dashboard(200000, 3);
+    for (size_t i = 0; i < 200000; i++) {
+        dashboard.setCell(i, 0, i * 0.1);
+    }
+    dashboard.setFormula(0, 1, 0, 0, 199999, 0, FormulaCell::SUM);
+    dashboard.setFormula(
+        1, 1, 0, 0, 199999, 0, FormulaCell::SUM, FormulaCell::COMPENSATED);
+    dashboard.setFormula(2, 1, 0, 0, 199999, 0, FormulaCell::AVERAGE);
+    dashboard.setFormula(3, 1, 0, 1, 2, 1, FormulaCell::SUM);
+    for (size_t i = 0; i < 100; i++) {
+        dashboard.setFormula(i, 2, i, 0, i + 1000, 0, FormulaCell::PRODUCT);
+    }
+    Table recalculated = dashboard;
+    recalculated.recalculateAll(4);
+    assert(recalculated == dashboard);
+    dashboard.setCell(50, 0, "text");
+    recalculated.setCell(50, 0, "text");
+    recalculated.recalculateAll(3);
+    assert(recalculated == dashboard);
+    assert(recalculated.getCellValue(3, 1).getType() == Cell::EMPTY);
+    assert(recalculated.getCellValue(51, 2).getType() == Cell::NUMBER);
+    // Ячейки формул пусты в разреженном столбце, как после чтения файла
+    const char* blankName = "test_recalc.csv";
+    {
+        std::ofstream csv(blankName, std::ios::binary);
+        csv << "1,\n2,\n3,\n";
+        for (size_t i = 3; i < 100000; i++) {
+            csv << ",\n";
+        }
+    }
+    Table blankSerial(100000, 2);
+    blankSerial.setFormula(10, 1, 0, 0, 2, 0, FormulaCell::SUM);
+    blankSerial.setFormula(11, 1, 10, 1, 10, 1, FormulaCell::SUM);
+    blankSerial.setFormula(12, 1, 10, 1, 11, 1, FormulaCell::SUM);
+    blankSerial.setFormula(70000, 1, 10, 1, 12, 1, FormulaCell::SUM);
+    Table blankParallel = blankSerial;
+    blankSerial.readFromFile(blankName, CsvOptions(',', '"', 1));
+    blankParallel.readFromFile(blankName, CsvOptions(',', '"', 4));
+    std::remove(blankName);
+    assert(blankSerial.getCellValue(11, 1).getNumber() == 6);
+    assert(blankSerial.getCellValue(70000, 1).getNumber() == 24);
+    assert(blankParallel == blankSerial);
+    blankSerial.setCell(0, 0, "text");
+    blankParallel.setCell(0, 0, "text");
+    blankSerial.setCell(0, 0, 4);
+    blankParallel.setCell(0, 0, 4);
+    blankSerial.recalculateAll(1);
+    blankParallel.recalculateAll(4);
+    assert(blankParallel.getCellValue(70000, 1).getNumber() == 36);
+    assert(blankParallel == blankSerial);
+
+    std::cout << "Тестирование вывода таблицы..." << std::endl;
+    Table printed(2, 2);
+    printed.setCell(0, 0, "abcdef");
+    printed.setCell(1, 0, 3.5);
+    std::ostringstream output;
+    output << printed;
+    assert(output.str() ==
+           "------------------\n"
+           "|abcdef |  None |  \n"
+           "------------------\n"
+           "|3.5    |  None |  \n"
+           "------------------\n");
+    printed.setCell(0, 0, "ab");
+    printed.setCell(1, 1, 1e-7);
+    output.str("");
+    output << printed;
+    assert(output.str() ==
+           "----------------\n"
+           "|ab  |  None  |  \n"
+           "----------------\n"
+           "|3.5 |  1e-07 |  \n"
+           "----------------\n");
+    output.str("");
+    printed.printRows(output, 1, 10);
+    assert(output.str() ==
+           "----------------\n"
+           "|3.5 |  1e-07 |  \n"
+           "----------------\n");
+
+    std::cout << "Тестирование одновременного чтения и записи..." << std::endl;
+    ConcurrentTable shared(Table(1000, 2));
+    std::atomic<bool> writing(true);
+    std::vector<std::thread> readers;
+    for (int k = 0; k < 4; k++) {
+        readers.emplace_back([&shared, &writing]() {
+            double last = 0;
+            while (writing.load()) {
+                ConcurrentTable::Snapshot version = shared.read();
+                if (version->getCellValue(0, 0).getType() != Cell::NUMBER) {
+                    continue;
+                }
+                double value = version->getCellValue(0, 0).getNumber();
+                assert(value >= last);
+                assert(version->calculateFormula(
+                           0, 0, 1, 0, FormulaCell::SUM) == 0);
+                last = value;
+            }
+        });
+    }
+    for (int k = 1; k <= 200; k++) {
+        shared.update([k](Table& table) {
+            table.setCell(0, 0, static_cast<double>(k));
+            table.setCell(1, 0, static_cast<double>(-k));
+        });
+    }
+    writing.store(false);
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    assert(shared.getCellValue(0, 0).getNumber() == 200);
+    assert(shared.calculateFormula(0, 0, 1, 0, FormulaCell::SUM) == 0);
+    std::vector<std::thread> writers; // Записи ждущих писателей
+                                      // публикуются вместе
+    for (size_t t = 0; t < 4; t++) {
+        writers.emplace_back([&shared, t]() {
+            for (size_t i = 0; i < 100; i++) {
+                shared.setCell(2 + t * 100 + i, 1, static_cast<double>(i));
+            }
+            bool outside = false;
+            try {
+                shared.setCell(1000 + t, 1, "outside");
+            } catch (const std::out_of_range&) {
+                outside = true;
+            }
+            assert(outside);
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    assert(shared.calculateFormula(2, 1, 401, 1, FormulaCell::SUM) == 19800);
+    {
+        std::vector<ConcurrentTable::Snapshot> held; // Все ячейки читателей
+                                                     // заняты
+        for (size_t k = 0; k < 200; k++) {
+            held.push_back(shared.read());
+        }
+        shared.setCell(0, 0, 201.0);
+        assert(held.front()->getCellValue(0, 0).getNumber() == 200);
+        assert(held.back()->getCellValue(0, 0).getNumber() == 200);
+        assert(shared.read()->getCellValue(0, 0).getNumber() == 201);
+    }
+    Table formulaSource(3, 1); // Версия делит формулы, пока не изменит их
+    formulaSource.setFormula(2, 0, 0, 0, 1, 0, FormulaCell::SUM);
+    Table formulaCopy = formulaSource;
+    formulaCopy.setCell(0, 0, 5.0);
+    formulaCopy.setFormula(1, 0, 0, 0, 0, 0, FormulaCell::SUM);
+    assert(formulaCopy.getCellValue(2, 0).getNumber() == 10);
+    assert(formulaSource.isFormula(2, 0) && !formulaSource.isFormula(1, 0));
+    assert(formulaSource.getCellValue(2, 0).getType() == Cell::EMPTY);
+    Table headed(100000, 3);
+    headed.setCell(0, 0, "id");
+    headed.setCell(0, 1, "name");
+    headed.setCell(0, 2, "name");
+    ConcurrentTable renamed(headed);
+    renamed.update([](Table& table) { // Названия обновляются без перестройки
+        table.setCell(0, 1, "title");
+        table.setCell(5, 0, 5.0);
+    });
+    assert(renamed.read()->findColumn("title") == 1);
+    assert(renamed.read()->findColumn("name") == 2);
+    renamed.update([](Table& table) { table.setCell(0, 2, "title"); });
+    assert(renamed.read()->findColumn("title") == 1);
+    bool unnamed = false;
+    try {
+        renamed.read()->findColumn("name");
+    } catch (const std::invalid_argument&) {
+        unnamed = true;
+    }
+    assert(unnamed);
+
+    std::cout << "Тестирование чтения CSV-файла..." << std::endl;
+    const char* csvName = "test_table.csv";
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        csv << "name;date;money\r\n"
+               "\"Ivanov; Ivan\";2024-09-15;1e3\r\n"
+               "\"say \"\"hi\"\"\nagain\";;-2.5\n"
+               "short\n";
+    }
+    Table     csvTable;
+    ReadStats stats = csvTable.readFromFile(csvName, CsvOptions(';'));
+    std::remove(csvName);
+    assert(stats.rows == 4 && csvTable.getSize().second == 3);
+    assert(csvTable.getCellValue(1, 0).getText() == "Ivanov; Ivan");
+    assert(csvTable.getCellValue(1, 1).getText() == "2024-09-15");
+    assert(csvTable.getCellValue(1, 2).getNumber() == 1000);
+    assert(csvTable.getCellValue(2, 0).getText() == "say \"hi\"\nagain");
+    assert(csvTable.getCellValue(2, 1).getType() == Cell::EMPTY);
+    assert(csvTable.getCellValue(3, 2).getType() == Cell::EMPTY);
+    assert(csvTable.calculateFormula(1, 2, 2, 2, FormulaCell::SUM) == 997.5);
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        csv << "\"ab\"cd,1\n\n\"x\"\r\n\r\n\"q\"\"\" tail\r\n3,4";
+    }
+    for (bool lazyParse : {false, true}) { // Пустые строки пропускаются,
+                                           // хвост после кавычки остается
+        Table lenient;
+        stats = lenient.readFromFile(csvName,
+                                     CsvOptions(',', '"', 1, lazyParse));
+        assert(stats.rows == 4 && lenient.getSize().second == 2);
+        assert(lenient.getCellValue(0, 0).getText() == "abcd");
+        assert(lenient.getCellValue(1, 0).getText() == "x");
+        assert(lenient.getCellValue(1, 1).getType() == Cell::EMPTY);
+        assert(lenient.getCellValue(2, 0).getText() == "q\" tail");
+        assert(lenient.getCellValue(3, 1).getNumber() == 4);
+    }
+    std::remove(csvName);
+
+    std::cout << "Тестирование параллельного чтения CSV-файла..." << std::endl;
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        for (int i = 0; i < 100; i++) {
+            csv << i << ",\"multi\nline, " << i << "\"";
+            if (i == 57) {
+                csv << ",extra";
+            }
+            csv << "\n";
+        }
+    }
+    Table parallelTable;
+    stats = parallelTable.readFromFile(csvName, CsvOptions(',', '"', 4));
+    std::remove(csvName);
+    assert(stats.threads == 4 && stats.rows == 100);
+    assert(parallelTable.getSize().second == 3);
+    assert(parallelTable.getCellValue(99, 1).getText() == "multi\nline, 99");
+    assert(parallelTable.getCellValue(57, 2).getText() == "extra");
+    assert(parallelTable.getCellValue(58, 2).getType() == Cell::EMPTY);
+    assert(parallelTable.calculateFormula(0, 0, 99, 0, FormulaCell::SUM) ==
+           4950);
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        for (int i = 0; i < 400; i++) { // Кавычка внутри поля без кавычек
+            csv << i << (i == 1 ? ",5\" disk" : ",\"quoted\nfield\"") << "\n";
+        }
+    }
+    Table serial, strayQuotes;
+    serial.readFromFile(csvName, CsvOptions(',', '"', 1));
+    stats = strayQuotes.readFromFile(csvName, CsvOptions(',', '"', 4));
+    assert(stats.threads == 4 && stats.rows == 400 && strayQuotes == serial);
+    assert(strayQuotes.getCellValue(399, 1).getText() == "quoted\nfield");
+    assert(strayQuotes.getCellValue(1, 1).getText() == "5\" disk");
+    CsvStream strayStream(csvName, CsvOptions(), 64);
+    Table     strayBatch;
+    size_t    strayRows = 0;
+    while (strayStream.next(strayBatch)) {
+        for (size_t i = 0; i < strayBatch.getSize().first; i++) {
+            assert(strayBatch.getCellValue(i, 0).getNumber() ==
+                   static_cast<double>(strayRows + i));
+        }
+        strayRows += strayBatch.getSize().first;
+    }
+    assert(strayRows == 400);
+    std::remove(csvName);
+
+    std::cout << "Тестирование ленивого чтения CSV-файла..." << std::endl;
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        for (int i = 0; i < 150000; i++) {
+            csv << i << ",\"say \"\"" << i % 10 << "\"\"\","
+                << (i % 3 ? "x" : "");
+            if (i == 70000) {
+                csv << ",\"extra, field\"";
+            }
+            csv << "\r\n";
+        }
+    }
+    Table eager, lazy;
+    eager.readFromFile(csvName, CsvOptions(',', '"', 4));
+    stats = lazy.readFromFile(csvName, CsvOptions(',', '"', 4, true));
+    std::remove(csvName);
+    assert(stats.rows == 150000 && lazy.getSize().second == 4);
+    Table                    lazyCopy = lazy; // Делит неразобранные столбцы
+    const Table&             lazyView = lazy;
+    std::vector<std::thread> touches; // Первое обращение из многих потоков
+    for (size_t t = 0; t < 4; t++) {
+        touches.push_back(std::thread([&lazyView]() {
+            assert(lazyView.calculateFormula(
+                       0, 0, 149999, 0, FormulaCell::SUM) ==
+                   149999.0 * 150000 / 2);
+        }));
+    }
+    for (std::thread& touch : touches) {
+        touch.join();
+    }
+    assert(lazy.getCellValue(5, 1).getText() == "say \"5\"");
+    assert(lazy.getCellValue(3, 2).getType() == Cell::EMPTY);
+    assert(lazy.getCellValue(4, 2).getText() == "x");
+    assert(lazy.getCellValue(70000, 3).getText() == "extra, field");
+    assert(lazy.getCellValue(70001, 3).getType() == Cell::EMPTY);
+    assert(lazy == eager);
+    lazy.setCell(0, 2, "changed");
+    assert(lazy.getCellValue(0, 2).getText() == "changed");
+    assert(lazyCopy.getCellValue(0, 2).getType() == Cell::EMPTY);
+    assert(!(lazy == eager) && lazyCopy == eager);
+
+    std::cout << "Тестирование потокового чтения CSV-файла..." << std::endl;
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        csv << "id,value\n";
+        for (int i = 1; i <= 1000; i++) {
+            csv << i << ",\"" << i * 0.5 << "\"" << (i % 7 ? "" : ",\"\n\"")
+                << "\n";
+        }
+    }
+    CsvStream stream(csvName, CsvOptions(), 64);
+    Table     batch;
+    size_t    batches = 0, streamed = 0;
+    while (stream.next(batch)) {
+        assert(stream.batchStart() == streamed);
+        streamed += batch.getSize().first;
+        batches++;
+    }
+    assert(streamed == 1001 && batches == 16);
+    assert(CsvStream::calculateFormula(csvName,
+                                       CsvOptions(),
+                                       1,
+                                       0,
+                                       1000,
+                                       0,
+                                       FormulaCell::SUM,
+                                       FormulaCell::FAST,
+                                       64) == 500500);
+    assert(CsvStream::calculateFormula(
+               csvName, CsvOptions(), 100, 1, 199, 1, FormulaCell::AVERAGE) ==
+           74.75);
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        csv << "1,2,3\n4,5,6\n";
+        for (int i = 0; i < 200; i++) { // Порции дальше уже первой
+            csv << i << "," << i << "\n";
+        }
+    }
+    assert(CsvStream::calculateFormula(csvName,
+                                       CsvOptions(),
+                                       0,
+                                       0,
+                                       201,
+                                       1,
+                                       FormulaCell::SUM,
+                                       FormulaCell::FAST,
+                                       64) == 39812);
+    Table ragged;
+    ragged.readFromFile(csvName);
+    for (size_t rowFrom : {0, 100}) {
+        bool streamError = false, loadedError = false;
+        try {
+            CsvStream::calculateFormula(csvName,
+                                        CsvOptions(),
+                                        rowFrom,
+                                        1,
+                                        201,
+                                        2,
+                                        FormulaCell::SUM,
+                                        FormulaCell::FAST,
+                                        64);
+        } catch (const std::runtime_error&) {
+            streamError = true;
+        }
+        try {
+            ragged.calculateFormula(rowFrom, 1, 201, 2, FormulaCell::SUM);
+        } catch (const std::runtime_error&) {
+            loadedError = true;
+        }
+        assert(streamError && loadedError);
+    }
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        for (int i = 0; i < 5000; i++) { // Неповторяющиеся длинные строки
+            csv << i << ",session identifier number " << i << "\n";
+        }
+    }
+    {
+        size_t          pooled = StringPool::instance().size();
+        Stats::Snapshot before = Stats::snapshot();
+        {
+            CsvStream logStream(csvName, CsvOptions(), 100);
+            Table     logBatch;
+            size_t    largest = pooled;
+            while (logStream.next(logBatch)) { // Строки прежних порций
+                                               // уходят из пула
+                largest = std::max(largest, StringPool::instance().size());
+            }
+            assert(largest <= pooled + 100);
+        }
+        assert(StringPool::instance().size() == pooled);
+        assert(CsvStream::calculateFormula(csvName,
+                                           CsvOptions(),
+                                           0,
+                                           0,
+                                           4999,
+                                           0,
+                                           FormulaCell::SUM,
+                                           FormulaCell::FAST,
+                                           100) == 4999.0 * 2500);
+        assert(StringPool::instance().size() == pooled);
+        assert(Stats::snapshot().counters[Stats::STRING_ALLOCATIONS] -
+                   before.counters[Stats::STRING_ALLOCATIONS] ==
+               (Stats::enabled() ? 5000u : 0u));
+    }
+    std::remove(csvName);
+
+    std::cout << "Тестирование двоичного формата таблицы..." << std::endl;
+    const char* binaryName = "test_table.bin";
+    Table       saved(70000, 2);
+    for (size_t i = 0; i < 70000; i++) {
+        saved.setCell(i, 0, static_cast<double>(i));
+    }
+    saved.setCell(5, 1, "short");
+    saved.setCell(69999, 1, "a rather long text for the pool");
+    saved.save(binaryName);
+    Table opened = Table::open(binaryName);
+    assert(opened == saved);
+    assert(opened.getCellValue(69999, 1).getText() ==
+           "a rather long text for the pool");
+    ColumnSummary summary = opened.getColumnSummary(0);
+    assert(summary.numbers == 70000 && summary.min == 0);
+    assert(summary.max == 69999 && summary.sum == 69999.0 * 35000);
+    assert(opened.getColumnSummary(1).numbers == 0);
+    assert(opened.calculateFormula(0, 0, 69999, 0, FormulaCell::SUM) ==
+           summary.sum);
+    opened.setCell(69999, 0, -1);
+    assert(opened.getCellValue(69998, 0).getNumber() == 69998);
+    assert(opened.getColumnSummary(0).max == 69998);
+    assert(opened.calculateFormula(69998, 0, 69999, 0, FormulaCell::SUM) ==
+           69997);
+    std::vector<Cell> unrelated; // Посторонние строки сдвигают номера пула
+    for (size_t k = 0; k < 100; k++) {
+        unrelated.push_back(
+            Cell("an unrelated long string number " + std::to_string(k)));
+    }
+    const char* resavedName = "test_table_copy.bin";
+    Table::open(binaryName).save(resavedName);
+    Table roundTrip = Table::open(resavedName);
+    std::remove(resavedName);
+    assert(roundTrip == saved);
+    assert(roundTrip.getCellValue(69999, 1).getText() ==
+           "a rather long text for the pool");
+    for (int patch = 0; patch < 2; patch++) { // Испорченные типы и длины
+        saved.save(binaryName);
+        {
+            std::fstream patched(
+                binaryName, std::ios::binary | std::ios::in | std::ios::out);
+            uint64_t tagsOffset; // Второе поле описания первого столбца
+            patched.seekg(64 + sizeof(uint64_t));
+            patched.read(reinterpret_cast<char*>(&tagsOffset),
+                         sizeof(tagsOffset));
+            patched.seekp(static_cast<std::streamoff>(tagsOffset) + 6);
+            patched.put(patch == 0 ? 0 : 20); // Длина текста первой ячейки
+            patched.put(patch == 0 ? 7 : Cell::TEXT); // Тип первой ячейки
+        }
+        Table damaged = Table::open(binaryName); // Блоки проверяются при
+                                                 // первом обращении
+        assert(damaged.getCellValue(69999, 0).getNumber() == 69999);
+        assert(damaged.getCellValue(0, 1).getType() == Cell::EMPTY);
+        bool rejected = false;
+        try {
+            damaged.getCellValue(0, 0);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        assert(rejected);
+    }
+    { // Строки словаря попадают в пул только при чтении ячеек с ними и
+      // уходят из него вместе с файлом
+        size_t pooled = StringPool::instance().size();
+        {
+            Table dictionary(2, 1);
+            dictionary.setCell(0, 0, "the first string of a dictionary");
+            dictionary.setCell(1, 0, "the second string of a dictionary");
+            dictionary.save(binaryName);
+        }
+        assert(StringPool::instance().size() == pooled);
+        {
+            Table mapped = Table::open(binaryName);
+            assert(StringPool::instance().size() == pooled);
+            assert(mapped.getCellValue(1, 0).getTextView() ==
+                   "the second string of a dictionary");
+            assert(StringPool::instance().size() == pooled + 1);
+        }
+        assert(StringPool::instance().size() == pooled);
+    }
+    std::remove(binaryName);
+
+    std::cout << "Тест метода индентификации класса..." << std::endl;
+    assert(tableLast.identify() == "Table");
+
+    std::cout << "Тест оператора равенства..." << std::endl;
+    Table copyLastTable = tableLast;
+    assert(tableLast == copyLastTable);
+
+    std::cout << "Тест опратора сложения..." << std::endl;
+    Table anotherCopyLastTable = copyLastTable;
+    copyLastTable += tableLast;
+    assert(copyLastTable == (anotherCopyLastTable + tableLast));
+
+    std::cout << "Тест сравнения таблиц по отпечаткам блоков..." << std::endl;
+    Table nightly(150000, 2);
+    nightly.setCell(10, 0, 1.5);
+    nightly.setCell(149999, 1, "a long text that lives in the pool");
+    Table reconciled = nightly;
+    assert(reconciled == nightly && reconciled.diff(nightly).empty());
+    reconciled.setCell(10, 0, 2.5);
+    reconciled.setCell(10, 0, 1.5);
+    assert(reconciled == nightly);
+    reconciled.setCell(70000, 1, "x");
+    reconciled.setCell(70001, 1, "y");
+    reconciled.setCell(149999, 1, "another long text that lives in the pool");
+    assert(!(reconciled == nightly));
+    std::vector<CellRange> changes = reconciled.diff(nightly);
+    assert(changes.size() == 2);
+    assert(changes[0] == CellRange(70000, 1, 70001, 1));
+    assert(changes[1] == CellRange(149999, 1, 149999, 1));
+    changes = Table(2, 3).diff(Table(3, 2));
+    assert(changes.size() == 2 && changes[0] == CellRange(0, 2, 1, 2));
+    assert(changes[1] == CellRange(2, 0, 2, 2));
+    Table missing(4, 1); // NaN равен себе при любых границах блоков
+    missing.setCell(1, 0, std::nan(""));
+    missing.setCell(2, 0, -0.0);
+    Table missingHead(2, 1), missingTail(2, 1);
+    missingHead.setCell(1, 0, std::nan(""));
+    missingTail.setCell(0, 0, 0.0);
+    missingHead.appendRows(missingTail);
+    assert(missing == Table(missing) && missing == missingHead);
+    assert(missingHead == missing && missing.diff(missingHead).empty());
+    missingHead.setCell(1, 0, std::nan("1"));
+    assert(!(missing == missingHead) && missing.diff(missingHead).size() == 1);
+
+    std::cout << "Тест объединения таблиц по строкам..." << std::endl;
+    Table daily(3, 2);
+    for (size_t i = 0; i < 3; i++) {
+        daily.setCell(i, 0, static_cast<double>(i));
+        daily.setCell(i, 1, "day");
+    }
+    daily.setFormula(2, 1, 0, 0, 1, 0, FormulaCell::SUM);
+    Table stacked(0, 2);
+    for (int k = 0; k < 100; k++) {
+        stacked.appendRows(daily);
+    }
+    assert(stacked.getSize().first == 300);
+    assert(stacked.getCellValue(299, 0).getNumber() == 2);
+    assert(stacked.calculateFormula(0, 0, 299, 0, FormulaCell::SUM) == 300);
+    assert(stacked.isFormula(296, 1) && !stacked.isFormula(297, 1));
+    stacked.setCell(297, 0, 5.0);
+    assert(stacked.getCellValue(299, 1).getNumber() == 6);
+    assert(daily.getCellValue(0, 0).getNumber() == 0);
+    stacked.appendRows(stacked);
+    assert(stacked.getSize().first == 600);
+    assert(stacked.getCellValue(597, 0).getNumber() == 5);
+    bool unionError = false;
+    try {
+        stacked.appendRows(Table(1, 3));
+    } catch (const std::invalid_argument&) {
+        unionError = true;
+    }
+    assert(unionError);
+
+    std::cout << "Тест группировки строк..." << std::endl;
+    Table sales(100001, 3);
+    sales.setCell(0, 0, "region");
+    sales.setCell(0, 1, "amount");
+    sales.setCell(0, 2, "count");
+    for (size_t i = 1; i <= 100000; i++) {
+        sales.setCell(i, 0, i % 3 ? "north" : "a region with a long name");
+        sales.setCell(i, 1, static_cast<double>(i % 1000) / 8);
+        sales.setCell(i, 2, static_cast<double>(i % 7));
+    }
+    std::vector<Aggregation> totals;
+    totals.push_back(Aggregation{1, FormulaCell::SUM});
+    totals.push_back(Aggregation{2, FormulaCell::AVERAGE});
+    Table byRegion = sales.groupBy({0}, totals, GroupOptions(1, 0, true));
+    assert(byRegion.getSize().first == 3 && byRegion.getSize().second == 3);
+    assert(byRegion.getCellValue(0, 1).getText() == "SUM(amount)");
+    assert(byRegion.getCellValue(1, 0).getText() == "north");
+    assert(byRegion.getCellValue(2, 0).getText() ==
+           "a region with a long name");
+    assert(byRegion.getCellValue(1, 1).getNumber() +
+               byRegion.getCellValue(2, 1).getNumber() ==
+           sales.calculateFormula(1, 1, 100000, 1, FormulaCell::SUM));
+    assert(byRegion == sales.groupBy({0}, totals, GroupOptions(4, 0, true)));
+    Table byPair = sales.groupBy({0, 2}, totals, GroupOptions(4, 0, true));
+    assert(byPair.getSize().first == 15);
+    assert(byPair.getCellValue(0, 0).getText() == "region");
+    assert(byPair ==
+           sales.groupBy({0, 2}, totals, GroupOptions(3, 256, true)));
+    bool groupError = false;
+    try {
+        sales.groupBy({0}, totals);
+    } catch (const std::runtime_error&) {
+        groupError = true;
+    }
+    assert(groupError);
+    Table visits(100000, 2); // Групп много больше, чем помещается в бюджет
+    for (size_t i = 0; i < 100000; i++) {
+        visits.setCell(i, 0, static_cast<double>(i * 7919 % 5000));
+        visits.setCell(i, 1, static_cast<double>(i % 13) / 4);
+    }
+    std::vector<Aggregation> visitTotals;
+    visitTotals.push_back(Aggregation{1, FormulaCell::SUM});
+    visitTotals.push_back(Aggregation{1, FormulaCell::PRODUCT});
+    Table           byVisitor = visits.groupBy({0}, visitTotals);
+    Stats::Snapshot unspilled = Table::stats();
+    for (size_t threads = 1; threads <= 4; threads *= 2) {
+        assert(byVisitor == visits.groupBy({0},
+                                           visitTotals,
+                                           GroupOptions(threads, 2048)));
+    }
+    assert(byVisitor.getSize().first == 5000);
+    if (Stats::enabled()) {
+        assert(Table::stats().counters[Stats::GROUP_SPILLED_ROWS] >
+               unspilled.counters[Stats::GROUP_SPILLED_ROWS] + 100000);
+    }
+
+    std::cout << "Тест отбора строк по условию..." << std::endl;
+    std::vector<size_t> north = sales.select(
+        Predicate::equal(0, "north") && Predicate::greaterEqual(2, 5), 1);
+    assert(north.size() == 19047 && north[0] == 5 && north[1] == 13);
+    std::vector<size_t> either = sales.select(
+        Predicate::startsWith(0, "a region") || Predicate::less(1, 0.5));
+    assert(either.size() == 33600 && either[0] == 1);
+    assert(sales.select(Predicate::isEmpty(2)).empty());
+    assert(sales.select(Predicate::notEqual(1, -1)).size() == 100000);
+    assert(sales.calculateFormula(north, 2, 2, FormulaCell::SUM) == 104758);
+    Table northSales = sales.filter(
+        Predicate::equal(0, "north") && Predicate::greaterEqual(2, 5), 1);
+    assert(northSales.getSize().first == 19048);
+    assert(northSales.getCellValue(0, 2).getText() == "count");
+    assert(northSales.getCellValue(2, 2).getNumber() == 6);
+    assert(northSales.calculateFormula(1, 1, 19047, 1, FormulaCell::SUM) ==
+           sales.calculateFormula(north, 1, 1, FormulaCell::SUM));
+    assert(sales.filter(Predicate::greater(1, 1e9)).getSize().first == 0);
+    Stats::Snapshot beforeQueries = Table::stats();
+    for (size_t k = 0; k < 100; k++) { // Запросы не пополняют пул строк
+        std::string query = "a region with a long name " + std::to_string(k);
+        assert(sales.select(Predicate::equal(0, query)).empty());
+        assert(sales.select(Predicate::startsWith(0, query)).empty());
+    }
+    assert(Table::stats().counters[Stats::STRING_ALLOCATIONS] ==
+           beforeQueries.counters[Stats::STRING_ALLOCATIONS]);
+    assert(sales.select(Predicate::equal(0, "a region with a long name"))
+               .size() ==
+           sales.select(Predicate::startsWith(0, "a region")).size());
+
+    std::cout << "Тест сортировки строк..." << std::endl;
+    Table ranked(200001, 2);
+    ranked.setCell(0, 0, "score");
+    for (size_t i = 1; i <= 200000; i++) {
+        double score = static_cast<double>((i * 7919) % 1000) - 500.5;
+        if (i % 11 == 0) {
+            ranked.setCell(i, 0, i % 2 ? "b" : "a long name of a player");
+        } else if (i % 13 != 0) {
+            ranked.setCell(i, 0, score);
+        }
+        ranked.setCell(i, 1, static_cast<double>(i % 3));
+    }
+    std::vector<SortKey> byScore = {{1, true}, {0, false}};
+    std::vector<size_t>  sortedRows =
+        ranked.sortedRows(byScore, SortOptions(1, true));
+    assert(sortedRows.size() == 200000);
+    assert(sortedRows == ranked.sortedRows(byScore, SortOptions(4, true)));
+    for (size_t k = 1; k < sortedRows.size(); k++) {
+        Cell   before = ranked.getCellValue(sortedRows[k - 1], 0);
+        Cell   after  = ranked.getCellValue(sortedRows[k], 0);
+        double group  = ranked.getCellValue(sortedRows[k - 1], 1).getNumber();
+        assert(group <= ranked.getCellValue(sortedRows[k], 1).getNumber());
+        if (group != ranked.getCellValue(sortedRows[k], 1).getNumber()) {
+            continue;
+        }
+        assert(before.getType() != Cell::TEXT ||
+               after.getType() != Cell::NUMBER);
+        assert(after.getType() == Cell::EMPTY ||
+               before.getType() != Cell::EMPTY);
+        if (before.getType() == after.getType()) {
+            if (before.getType() == Cell::NUMBER) {
+                assert(before.getNumber() >= after.getNumber());
+            } else if (before.getType() == Cell::TEXT) {
+                assert(before.getTextView() >= after.getTextView());
+            }
+            assert(before != after || sortedRows[k - 1] < sortedRows[k]);
+        }
+    }
+    Table sortedTable = ranked.sortBy({{0, true}}, SortOptions(2, true));
+    assert(sortedTable.getCellValue(0, 0).getText() == "score");
+    assert(sortedTable.getCellValue(1, 0).getNumber() == -500.5);
+    assert(sortedTable.getCellValue(200000, 0).getType() == Cell::EMPTY);
+    std::vector<size_t> best = ranked.topRows(0, 3, false, SortOptions(1));
+    assert(best.size() == 3);
+    assert(ranked.getCellValue(best[0], 0).getNumber() == 498.5);
+    assert(best[0] < best[1]);
+    assert(ranked.getCellValue(best[1], 0) == ranked.getCellValue(best[0], 0));
+    Table leaders = ranked.topK(0, 5, true, SortOptions(1, true));
+    assert(leaders.getSize().first == 6);
+    assert(leaders.getCellValue(5, 0).getNumber() == -500.5);
+
+    std::cout << "Тест вторичных индексов столбцов..." << std::endl;
+    Table users(1001, 3);
+    users.setCell(0, 0, "user_id");
+    users.setCell(0, 1, "date");
+    users.setCell(0, 2, "visits");
+    for (size_t i = 1; i <= 1000; i++) {
+        users.setCell(i, 0, static_cast<double>(i * 10));
+        users.setCell(
+            i, 1, i % 2 ? "2024-01-01" : "a date stored as long text");
+        users.setCell(i, 2, static_cast<double>(i % 100));
+    }
+    users.setFormula(1, 2, 2, 2, 3, 2, FormulaCell::SUM);
+    users.enableColumnIndex(0, ColumnIndex::HASH);
+    users.enableColumnIndex(1, ColumnIndex::HASH);
+    users.enableColumnIndex(2, ColumnIndex::ORDERED);
+    assert(users.findColumn("visits") == 2);
+    assert(users.findRows(0, Cell(420.0)) == std::vector<size_t>(1, 42));
+    assert(users.findRows(1, Cell("2024-01-01")).size() == 500);
+    assert(users.findRows(1, Cell("a date stored as long text"))[0] == 2);
+    assert(users.findRange(2, 98, 99) ==
+           users.select(Predicate::greaterEqual(2, 98) &&
+                        Predicate::lessEqual(2, 99)));
+    Table archived = users;
+    users.setCell(42, 0, -1);
+    users.setCell(2, 2, 1000); // Формула в (1, 2) пересчитывается
+    assert(users.findRows(0, Cell(420.0)).empty());
+    assert(users.findRows(0, Cell(-1.0)) == std::vector<size_t>(1, 42));
+    assert(users.findRange(2, 1000, 1000) == std::vector<size_t>(1, 2));
+    assert(users.findRange(2, 1003, 1003) == std::vector<size_t>(1, 1));
+    assert(archived.findRows(0, Cell(420.0)) == std::vector<size_t>(1, 42));
+    users.appendRows(archived);
+    assert(users.findRows(0, Cell(420.0)) == std::vector<size_t>(1, 1043));
+    users.recalculateAll(2);
+    assert(users.findRange(2, 5, 5) == users.select(Predicate::equal(2, 5)));
+    users += Table(2002, 1);
+    assert(users.findRows(1, Cell("2024-01-01")).size() == 1000);
+    users.setCell(0, 3, "extra");
+    assert(users.findColumn("extra") == 3);
+    bool unknownFeature = false;
+    try {
+        users.findColumn("missing");
+    } catch (const std::invalid_argument&) {
+        unknownFeature = true;
+    }
+    assert(unknownFeature);
+
+    std::cout << "Тест разреженной таблицы..." << std::endl;
+    Table sparse(1000000, 1000);
+    sparse.setCell(999999, 999, "corner");
+    for (size_t i = 200000; i < 200010; i++) {
+        sparse.setCell(i, 500, static_cast<double>(i - 200000));
+    }
+    assert(sparse.calculateFormula(200000, 500, 200009, 500,
+                                   FormulaCell::SUM) == 45);
+    assert(sparse.getCellValue(999999, 999).getText() == "corner");
+    assert(sparse.getCellValue(500000, 500).getType() == Cell::EMPTY);
+    assert(sparse.getColumnSummary(500).numbers == 10);
+    assert(sparse.select(Predicate::less(500, 5)).size() == 5);
+    assert(sparse.findRange(500, 3, 4) ==
+           std::vector<size_t>({200003, 200004}));
+    Table sparseCopy = sparse;
+    assert(sparseCopy == sparse);
+    sparseCopy.setCell(0, 0, 1.0);
+    assert(!(sparseCopy == sparse));
+    std::ostringstream sparseRows;
+    sparse.printRows(sparseRows, 200008, 200010);
+    assert(sparseRows.str().find("  9    |") != std::string::npos);
+    Table dense(70000, 1); // Блок становится плотным при заполнении
+    for (size_t i = 0; i < 70000; i += 2) {
+        dense.setCell(i, 0, static_cast<double>(i % 10));
+    }
+    for (size_t i = 0; i < 70000; i++) {
+        assert(dense.getCellValue(i, 0).getType() ==
+               (i % 2 ? Cell::EMPTY : Cell::NUMBER));
+    }
+    assert(dense.calculateFormula(0, 0, 0, 0, FormulaCell::SUM) == 0);
+    assert(dense.getColumnSummary(0).numbers == 35000);
+    assert(dense.getColumnSummary(0).sum == 35000 / 5 * 20);
+
+    std::cout << "Тест статистики операций..." << std::endl;
+    Stats::Snapshot before = Table::stats();
+    Table           counted(3, 2);
+    counted.setCell(0, 0, 1.0);
+    counted.setCell(1, 0, 2.0);
+    counted.setCell(2, 0, 3.0);
+    assert(counted.calculateFormula(0, 0, 2, 0, FormulaCell::SUM) == 6);
+    assert(counted.calculateFormula(0, 0, 1, 0, FormulaCell::AVERAGE) == 1.5);
+    counted.getCell(0, 1);
+    std::ostringstream countedOut;
+    countedOut << counted;
+    counted += Table(3, 1);
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        csv << "1;2\nx;4\n5\n"; // Одно текстовое поле и одна короткая строка
+    }
+    Table     countedCsv;
+    ReadStats countedRead = countedCsv.readFromFile(csvName, CsvOptions(';'));
+    assert(countedRead.rows == 3);
+    assert(countedRead.textFields == 1);
+    assert(countedRead.paddedRows == 1);
+    std::remove(csvName);
+    bool failed = false;
+    try {
+        countedCsv.readFromFile(csvName, CsvOptions(';'));
+    } catch (const std::runtime_error&) {
+        failed = true;
+    }
+    assert(failed);
+    std::vector<std::thread> counters;
+    for (size_t t = 0; t < 4; t++) { // Счетчики потоков складываются
+        counters.push_back(std::thread([&counted]() {
+            for (size_t k = 0; k < 100; k++) {
+                counted.calculateFormula(0, 0, 2, 0, FormulaCell::PRODUCT);
+            }
+        }));
+    }
+    for (std::thread& counter : counters) {
+        counter.join();
+    }
+    Stats::Snapshot after = Table::stats();
+    if (Stats::enabled()) {
+        assert(after.counters[Stats::FORMULA_CALLS] -
+                   before.counters[Stats::FORMULA_CALLS] ==
+               402);
+        assert(after.counters[Stats::FORMULA_CELLS] -
+                   before.counters[Stats::FORMULA_CELLS] ==
+               1205);
+        assert(after.calls[Stats::FORMULA_PRODUCT] -
+                   before.calls[Stats::FORMULA_PRODUCT] ==
+               400);
+        assert(after.counters[Stats::CELL_ALLOCATIONS] >
+               before.counters[Stats::CELL_ALLOCATIONS]);
+        assert(after.counters[Stats::RENDER_CELLS] -
+                   before.counters[Stats::RENDER_CELLS] ==
+               6);
+        assert(after.counters[Stats::CONCAT_CALLS] -
+                   before.counters[Stats::CONCAT_CALLS] ==
+               1);
+        assert(after.counters[Stats::READ_CALLS] -
+                   before.counters[Stats::READ_CALLS] ==
+               2);
+        assert(after.counters[Stats::READ_FAILURES] -
+                   before.counters[Stats::READ_FAILURES] ==
+               1);
+        assert(after.counters[Stats::READ_BYTES] -
+                   before.counters[Stats::READ_BYTES] ==
+               10);
+        assert(after.counters[Stats::READ_ROWS] -
+                   before.counters[Stats::READ_ROWS] ==
+               3);
+        assert(after.counters[Stats::READ_TEXT_FIELDS] -
+                   before.counters[Stats::READ_TEXT_FIELDS] ==
+               1);
+        assert(after.counters[Stats::READ_PADDED_ROWS] -
+                   before.counters[Stats::READ_PADDED_ROWS] ==
+               1);
+        assert(after.quantile(Stats::FORMULA_PRODUCT, 0.5) > 0);
+    } else {
+        assert(after.counters[Stats::FORMULA_CALLS] == 0);
+    }
+    {
+        std::ofstream csv(csvName, std::ios::binary);
+        csv << "1;a\n2\n3;4;5\n6\n";
+    }
+    for (size_t threads = 1; threads <= 3; threads++) { // Короткие строки
+                                                        // считаются по
+                                                        // ширине всех частей
+        for (bool lazy : {false, true}) {
+            Table     shaped;
+            ReadStats read = shaped.readFromFile(
+                csvName, CsvOptions(';', '"', threads, lazy));
+            assert(read.rows == 4);
+            assert(read.paddedRows == 3);
+            assert(read.textFields == (lazy ? 0u : 1u));
+            assert(shaped.getCellValue(1, 2).getType() == Cell::EMPTY);
+        }
+    }
+    std::remove(csvName);
+    std::ostringstream json, prometheus;
+    after.writeJson(json);
+    after.writePrometheus(prometheus);
+    assert(json.str().find("\"formula_calls\": ") != std::string::npos);
+    assert(prometheus.str().find("table_latency_seconds_count{operation="
+                                 "\"formula_product\"}") !=
+           std::string::npos);
+    const char* statsName = "test_stats.prom";
+    after.save(statsName, Stats::PROMETHEUS);
+    {
+        std::ifstream saved(statsName);
+        std::string   first;
+        std::getline(saved, first);
+        assert(first == "# TYPE table_read_calls_total counter");
+    }
+    std::remove(statsName);
+
+    std::cout << "Тест метода, возвращающего вектор признаков..." << std::endl;
+    std::vector<std::string> features;
+    features.push_back("A");
+    features.push_back("B");
+    assert(features == anotherCopyLastTable.getFeatureNames());
+
+    std::cout << "Все тесты пройдены успешно!" << std::endl;
+}